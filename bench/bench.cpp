@@ -0,0 +1,301 @@
+// Runs hyprwayland-scanner over a corpus of protocols, in server and client mode,
+// and reports the time and peak RSS of each scanner phase, plus what the generated
+// code costs: output size, compile time and object size.
+
+#include <iostream>
+#include <string>
+#include <format>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <chrono>
+#include <sstream>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+struct SRunResult {
+    bool                                      ok       = false;
+    uint64_t                                  wallUs   = 0;
+    long                                      maxRssKb = 0;
+    std::unordered_map<std::string, uint64_t> stats; // from --stats
+};
+
+struct SProtoResult {
+    std::string                               proto;
+    std::string                               mode;
+    std::unordered_map<std::string, uint64_t> stats; // medians
+    uint64_t                                  wallUs     = 0;
+    long                                      maxRssKb   = 0;
+    uint64_t                                  headerSize = 0;
+    uint64_t                                  sourceSize = 0;
+    uint64_t                                  compileUs  = 0;
+    uint64_t                                  objectSize = 0;
+    bool                                      compiled   = false;
+};
+
+static const std::vector<std::string> PHASES = {"load", "parse", "header", "source", "write"};
+
+// runs argv, returning its stdout. Wall time and peak RSS go into result.
+std::string run(const std::vector<std::string>& argv, SRunResult& result) {
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0)
+        return "";
+
+    const auto START = std::chrono::steady_clock::now();
+
+    const auto PID = fork();
+    if (PID < 0)
+        return "";
+
+    if (PID == 0) {
+        dup2(pipeFds[1], STDOUT_FILENO);
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+
+        std::vector<char*> args;
+        for (auto& a : argv) {
+            args.emplace_back(const_cast<char*>(a.c_str()));
+        }
+        args.emplace_back(nullptr);
+
+        execvp(args[0], args.data());
+        _exit(127);
+    }
+
+    close(pipeFds[1]);
+
+    std::string out;
+    char        buf[4096];
+    ssize_t     len = 0;
+    while ((len = read(pipeFds[0], buf, sizeof(buf))) > 0) {
+        out.append(buf, len);
+    }
+    close(pipeFds[0]);
+
+    int    status = 0;
+    rusage usage;
+    wait4(PID, &status, 0, &usage);
+
+    result.ok       = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    result.wallUs   = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - START).count();
+    result.maxRssKb = usage.ru_maxrss;
+
+    return out;
+}
+
+// picks the key=value pairs out of a --stats line
+void parseStats(const std::string& out, SRunResult& result) {
+    std::istringstream stream(out);
+    std::string        word;
+    while (stream >> word) {
+        const auto EQ = word.find('=');
+        if (EQ == std::string::npos)
+            continue;
+
+        try {
+            result.stats[word.substr(0, EQ)] = std::stoull(word.substr(EQ + 1));
+        } catch (std::exception& e) {
+            ;
+        }
+    }
+}
+
+template <typename T>
+T median(std::vector<T> values) {
+    if (values.empty())
+        return T{};
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+std::vector<std::string> splitArgs(const std::string& str) {
+    std::vector<std::string> out;
+    std::istringstream       stream(str);
+    std::string              word;
+    while (stream >> word) {
+        out.emplace_back(word);
+    }
+    return out;
+}
+
+std::vector<std::string> collectProtocols(const std::vector<std::string>& paths) {
+    std::vector<std::string> protos;
+    for (auto& path : paths) {
+        if (!std::filesystem::is_directory(path)) {
+            protos.emplace_back(path);
+            continue;
+        }
+
+        for (auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".xml")
+                protos.emplace_back(entry.path().string());
+        }
+    }
+
+    std::sort(protos.begin(), protos.end());
+    return protos;
+}
+
+void printUsage() {
+    std::cerr << "Usage: hyprwayland-scanner-bench --scanner <path> [--cxx <compiler>] [--cxxflags <flags>] [--iterations <n>] [--workdir <dir>] <xml or dir>...\n";
+}
+
+int main(int argc, char** argv) {
+    std::string              scanner, cxx, cxxflags;
+    std::string              workdir    = (std::filesystem::temp_directory_path() / "hyprwayland-scanner-bench").string();
+    size_t                   iterations = 5;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string curarg = argv[i];
+
+        const auto  nextArg = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << curarg << "\n";
+                exit(1);
+            }
+            return argv[++i];
+        };
+
+        if (curarg == "--scanner")
+            scanner = nextArg();
+        else if (curarg == "--cxx")
+            cxx = nextArg();
+        else if (curarg == "--cxxflags")
+            cxxflags = nextArg();
+        else if (curarg == "--workdir")
+            workdir = nextArg();
+        else if (curarg == "--iterations")
+            iterations = std::max(1UL, std::stoul(nextArg()));
+        else if (curarg.starts_with("-")) {
+            printUsage();
+            return 1;
+        } else
+            paths.emplace_back(curarg);
+    }
+
+    const auto PROTOS = collectProtocols(paths);
+
+    if (scanner.empty() || PROTOS.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<SProtoResult> results;
+
+    for (auto& proto : PROTOS) {
+        for (const std::string mode : {"server", "client"}) {
+            const auto OUTDIR = std::format("{}/{}", workdir, mode);
+            std::filesystem::create_directories(OUTDIR);
+
+            std::vector<std::string> argv = {scanner, "--stats", "--force", "-j", "1"};
+            if (mode == "client")
+                argv.emplace_back("--client");
+            argv.emplace_back(proto);
+            argv.emplace_back(OUTDIR);
+
+            SProtoResult                                            result;
+            std::vector<uint64_t>                                   walls;
+            std::vector<long>                                       rsses;
+            std::unordered_map<std::string, std::vector<uint64_t>>  stats;
+            bool                                                    failed = false;
+
+            result.proto = std::filesystem::path(proto).stem().string();
+            result.mode  = mode;
+
+            for (size_t i = 0; i < iterations; ++i) {
+                SRunResult iteration;
+                parseStats(run(argv, iteration), iteration);
+                if (!iteration.ok) {
+                    failed = true;
+                    break;
+                }
+
+                walls.emplace_back(iteration.wallUs);
+                rsses.emplace_back(iteration.maxRssKb);
+                for (auto& [k, v] : iteration.stats) {
+                    stats[k].emplace_back(v);
+                }
+            }
+
+            if (failed) {
+                std::cerr << std::format("scanner failed on {} ({})\n", proto, mode);
+                continue;
+            }
+
+            result.wallUs   = median(walls);
+            result.maxRssKb = median(rsses);
+            for (auto& [k, v] : stats) {
+                result.stats[k] = median(v);
+            }
+
+            const auto BASE   = std::format("{}/{}", OUTDIR, result.proto);
+            result.headerSize = std::filesystem::file_size(BASE + ".hpp");
+            result.sourceSize = std::filesystem::file_size(BASE + ".cpp");
+
+            if (!cxx.empty()) {
+                std::vector<std::string> cc = {cxx, "-std=c++23", "-c"};
+                for (auto& f : splitArgs(cxxflags)) {
+                    cc.emplace_back(f);
+                }
+                cc.emplace_back("-I" + OUTDIR);
+                cc.emplace_back(BASE + ".cpp");
+                cc.emplace_back("-o");
+                cc.emplace_back(BASE + ".o");
+
+                SRunResult compile;
+                run(cc, compile);
+                if (compile.ok) {
+                    result.compiled   = true;
+                    result.compileUs  = compile.wallUs;
+                    result.objectSize = std::filesystem::file_size(BASE + ".o");
+                } else
+                    std::cerr << std::format("compiling the generated {} ({}) failed\n", proto, mode);
+            }
+
+            results.emplace_back(std::move(result));
+        }
+    }
+
+    // report
+    std::cout << std::format("{:<48} {:<6} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9} {:>8} {:>8} {:>8} {:>10} {:>8}\n", "protocol", "mode", "load ms", "parse ms",
+                             "header ms", "source ms", "write ms", "total ms", "rss KiB", "allocs", "hpp KiB", "cpp KiB", "compile ms", "obj KiB");
+
+    SProtoResult total;
+    total.proto = "total";
+    for (auto& r : results) {
+        std::string line   = std::format("{:<48} {:<6}", r.proto, r.mode);
+        uint64_t    allocs = 0;
+        for (auto& phase : PHASES) {
+            line += std::format(" {:>9.3f}", r.stats[phase + "_us"] / 1000.0);
+            total.stats[phase + "_us"] += r.stats[phase + "_us"];
+            allocs += r.stats[phase + "_allocs"];
+        }
+        total.stats["allocs"] += allocs;
+
+        line += std::format(" {:>9.3f} {:>9} {:>8} {:>8.1f} {:>8.1f}", r.wallUs / 1000.0, r.maxRssKb, allocs, r.headerSize / 1024.0, r.sourceSize / 1024.0);
+        line += r.compiled ? std::format(" {:>10.1f} {:>8.1f}", r.compileUs / 1000.0, r.objectSize / 1024.0) : std::format(" {:>10} {:>8}", "-", "-");
+
+        total.wallUs += r.wallUs;
+        total.maxRssKb = std::max(total.maxRssKb, r.maxRssKb);
+        total.headerSize += r.headerSize;
+        total.sourceSize += r.sourceSize;
+        total.compileUs += r.compileUs;
+        total.objectSize += r.objectSize;
+
+        std::cout << line << "\n";
+    }
+
+    std::string line = std::format("{:<48} {:<6}", total.proto, "");
+    for (auto& phase : PHASES) {
+        line += std::format(" {:>9.3f}", total.stats[phase + "_us"] / 1000.0);
+    }
+    line += std::format(" {:>9.3f} {:>9} {:>8} {:>8.1f} {:>8.1f}", total.wallUs / 1000.0, total.maxRssKb, total.stats["allocs"], total.headerSize / 1024.0,
+                        total.sourceSize / 1024.0);
+    line += !cxx.empty() ? std::format(" {:>10.1f} {:>8.1f}", total.compileUs / 1000.0, total.objectSize / 1024.0) : std::format(" {:>10} {:>8}", "-", "-");
+    std::cout << line << "\n";
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <span>
+#include <functional>
+
+// libhyprwayland-scanner: the parser and generators of hyprwayland-scanner,
+// for tools that want bindings without running the binary and going through files.
+namespace HyprwaylandScanner {
+    struct SOptions {
+        bool waylandEnums   = false;
+        bool clientCode     = false;
+        bool noInterfaces   = false;
+        bool fwdHeader      = false; // also generate a <proto>-fwd.hpp with declarations only
+        bool module         = false; // generate a C++20 module interface unit instead of a header and source
+        bool amalgamated    = false; // the source goes into an amalgamation, see amalgamate()
+        bool delegate       = false; // store handlers in a non-allocating Hyprwayland::CDelegate instead of std::function
+        bool staticDispatch = false; // also generate CRTP templates that call the implementing class directly
+        bool pool           = false; // recycle objects through per-class Hyprwayland::CPool freelists
+        bool marshalArray   = false; // send messages through a wl_argument array instead of varargs
+        bool broadcast      = false; // server only: instance registries and broadcastX() senders
+        bool eventQueues    = false; // client only: overloads putting objects on a wl_event_queue of their own
+        bool instrument     = false; // per-message counters and handler time histograms
+        bool record         = false; // binary wire recorder, and on the server replaying recordings
+        bool benchHarness   = false; // also generate this side's half of a dispatch benchmark, <proto>-bench-<server|client>.cpp. Not with staticDispatch
+        bool loadgen        = false; // also generate a load generator server or client, <proto>-loadgen-<server|client>.cpp. The server not with staticDispatch
+
+        // split the source into this many TUs of similar size, <proto>-<i>.cpp,
+        // or with 0 into one per interface, <proto>-<interface>.cpp. Not for modules or amalgamations.
+        size_t sourceShards = 1;
+
+        // messages sent as interface.message, like wl_pointer.motion, to hold back until flushCoalesced(),
+        // keeping only the latest args. Only ones with int, uint and fixed args can be.
+        std::vector<std::string> coalesce;
+    };
+
+    // what a generated class costs at runtime
+    struct SInterfaceStats {
+        std::string name;
+        std::string className;
+        size_t      handlers      = 0; // F<> slots in its requests struct
+        size_t      estimatedSize = 0; // sizeof on the scanner's own ABI, with coalesced args. The other options only add statics
+    };
+
+    struct SProtocolImpl;
+    class CProtocol;
+
+    // the names of the files generated for a protocol, known before parsing it.
+    // Sources split per interface are not, see CProtocol::files()
+    std::vector<std::string> outputNames(std::string_view fileName, const SOptions& options);
+
+    // one umbrella header and the sources of all protocols in one or a few shards of similar size.
+    // The protocols need SOptions::amalgamated. With SOptions::module, it's an umbrella module instead.
+    std::vector<std::pair<std::string, std::string>> amalgamate(const std::vector<const CProtocol*>& protocols, std::string_view name, size_t shards = 1);
+    std::vector<std::string>                         amalgamationNames(std::string_view name, size_t shards, const SOptions& options);
+
+    std::string_view                                 version();
+
+    // the SOptions::coalesce entries that are no message these protocols send (requests with clientCode, events without).
+    // Each protocol only sees its own messages and leaves the others alone, so typos have to be caught up front with all of them.
+    std::vector<std::string> unknownCoalesced(const std::vector<std::string_view>& xmls, const SOptions& options);
+
+    // a parsed protocol. Generating is separate from parsing, so a tool can keep
+    // protocols around and only pay for the code it asks for.
+    class CProtocol {
+      public:
+        // parses xml in place. The buffer gets modified and has to outlive the protocol.
+        // fileName is what the generated files are named after, e.g. "xdg-shell".
+        // Throws std::runtime_error if the protocol can't be parsed.
+        CProtocol(std::span<char> xml, std::string_view fileName, const SOptions& options = {});
+
+        // same, on a copy of xml owned by the protocol
+        CProtocol(std::string xml, std::string_view fileName, const SOptions& options = {});
+
+        ~CProtocol();
+
+        CProtocol(const CProtocol&)            = delete;
+        CProtocol& operator=(const CProtocol&) = delete;
+
+        // the protocol's name, e.g. "xdg_shell"
+        std::string_view name() const;
+        std::string_view fileName() const;
+        const SOptions&  options() const;
+
+        // generate the header (and fwd header), then the source. Each runs once,
+        // generate() does whatever is left. Throw std::runtime_error on bad protocols.
+        void generateHeaders();
+        void generateSource();
+        void generate();
+
+        std::string_view header() const;
+        std::string_view source() const;
+        std::string_view fwdHeader() const;
+        std::string_view module() const;
+
+        // everything generated, named like the scanner writes it out, e.g. "xdg-shell.hpp"
+        std::vector<std::pair<std::string, std::string_view>> files() const;
+
+        // hands every generated file to sink, stops and returns false once sink does
+        bool write(const std::function<bool(const std::string& name, std::string_view content)>& sink) const;
+
+        std::vector<SInterfaceStats> interfaceStats() const;
+
+      private:
+        std::string                    ownedXml;
+        std::unique_ptr<SProtocolImpl> impl;
+
+        friend std::vector<std::pair<std::string, std::string>> amalgamate(const std::vector<const CProtocol*>& protocols, std::string_view name, size_t shards);
+    };
+}
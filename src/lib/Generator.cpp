@@ -0,0 +1,3529 @@
+#include "Generator.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+#include <functional>
+#include <stdexcept>
+
+using namespace HyprwaylandScanner;
+
+// F with --delegate: a std::function stand-in for handlers that are trivially copyable and fit
+// two pointers, like lambdas capturing this. Never allocates, moving one is a memcpy, and a call
+// is one indirect jump. Shared by every generated header, hence the guard.
+static constexpr std::string_view DELEGATE_DEFINITION = R"#(
+#ifndef HYPRWAYLAND_SCANNER_DELEGATE
+#define HYPRWAYLAND_SCANNER_DELEGATE
+namespace Hyprwayland {
+    template <typename>
+    class CDelegate;
+
+    template <typename R, typename... Args>
+    class CDelegate<R(Args...)> {
+      public:
+        CDelegate() = default;
+        CDelegate(std::nullptr_t) {}
+
+        template <typename T>
+            requires(!std::is_same_v<std::decay_t<T>, CDelegate> && std::is_invocable_r_v<R, std::decay_t<T>&, Args...>)
+        CDelegate(T&& fn) {
+            using Fn = std::decay_t<T>;
+            static_assert(sizeof(Fn) <= sizeof(storage) && alignof(Fn) <= alignof(void*), "handler too big for a delegate, capture less");
+            static_assert(std::is_trivially_copyable_v<Fn> && std::is_trivially_destructible_v<Fn>, "delegate handlers have to be trivially copyable");
+
+            // trivially copyable, so a copy of its bytes is one
+            const Fn HANDLER(std::forward<T>(fn));
+            std::memcpy(storage, &HANDLER, sizeof(Fn));
+            invoke = [](void* self, Args... args) -> R { return (*static_cast<Fn*>(self))(std::forward<Args>(args)...); };
+        }
+
+        R operator()(Args... args) const {
+            return invoke(storage, std::forward<Args>(args)...);
+        }
+
+        explicit operator bool() const {
+            return invoke != nullptr;
+        }
+
+      private:
+        alignas(void*) mutable unsigned char storage[sizeof(void*) * 2] = {};
+        R (*invoke)(void*, Args...) = nullptr;
+    };
+}
+#endif
+)#";
+
+// the per-class pool behind operator new/delete with --pool. A freelist over page-sized slabs
+// that are never given back, so the pool grows to the high water mark and stays there.
+// Not thread safe, like the classes themselves.
+static constexpr std::string_view POOL_DEFINITION = R"#(
+#ifndef HYPRWAYLAND_SCANNER_POOL
+#define HYPRWAYLAND_SCANNER_POOL
+namespace Hyprwayland {
+    struct SPoolStats {
+        size_t live      = 0; // objects in use
+        size_t highWater = 0; // most objects in use at once
+        size_t free      = 0; // recycled, ready to be reused
+        size_t slabs     = 0; // blocks taken from the heap
+    };
+
+    class CPool {
+      public:
+        constexpr CPool(size_t size, size_t align) : stride(((size < sizeof(void*) ? sizeof(void*) : size) + align - 1) / align * align) {}
+
+        void* allocate() {
+            if (!pFree)
+                grow();
+
+            void* p = pFree;
+            pFree   = *static_cast<void**>(p);
+
+            stats.free--;
+            if (++stats.live > stats.highWater)
+                stats.highWater = stats.live;
+
+            return p;
+        }
+
+        void deallocate(void* p) {
+            push(p);
+            stats.live--;
+        }
+
+        // grow until count more objects fit without touching the heap
+        void reserve(size_t count) {
+            while (stats.free < count) {
+                grow();
+            }
+        }
+
+        const SPoolStats& statistics() const {
+            return stats;
+        }
+
+      private:
+        void push(void* p) {
+            *static_cast<void**>(p) = pFree;
+            pFree                   = p;
+            stats.free++;
+        }
+
+        void grow() {
+            const size_t COUNT = stride < 4096 ? 4096 / stride : 1;
+            auto*        slab  = static_cast<unsigned char*>(::operator new(COUNT * stride));
+            for (size_t i = COUNT; i > 0; --i) {
+                push(slab + (i - 1) * stride);
+            }
+            stats.slabs++;
+        }
+
+        size_t     stride = 0;
+        void*      pFree  = nullptr;
+        SPoolStats stats;
+    };
+}
+#endif
+)#";
+
+// with --pool, the static dispatch templates pool their Impl, which the base class pool is too small for.
+// Classes deriving from Impl go to the heap again
+static constexpr std::string_view STATIC_POOL_PUBLIC = R"#(
+
+    // recycled through a Hyprwayland::CPool per Impl
+    static void* operator new(size_t size) {
+        if (size != sizeof(Impl))
+            return ::operator new(size);
+        return pool().allocate();
+    }
+
+    static void operator delete(void* p, size_t size) {
+        if (size != sizeof(Impl)) {
+            ::operator delete(p, size);
+            return;
+        }
+        pool().deallocate(p);
+    }
+
+    static const Hyprwayland::SPoolStats& poolStats() {
+        return pool().statistics();
+    }
+
+    static void reservePool(size_t count) {
+        pool().reserve(count);
+    })#";
+
+static constexpr std::string_view STATIC_POOL_PRIVATE = R"#(
+    // Impl is complete by the time this is instantiated
+    static Hyprwayland::CPool& pool() {
+        static constinit Hyprwayland::CPool POOL{sizeof(Impl), alignof(Impl)};
+        return POOL;
+    }
+)#";
+
+// what the static dispatch templates hand their base class. A type of its own rather than a const void*,
+// which a nullptr queue would match as well as the wl_event_queue* of the client constructor
+static constexpr std::string_view STATIC_IMPLEMENTATION_DEFINITION = R"#(
+#ifndef HYPRWAYLAND_SCANNER_STATIC_IMPLEMENTATION
+#define HYPRWAYLAND_SCANNER_STATIC_IMPLEMENTATION
+namespace Hyprwayland {
+    struct SStaticImplementation {
+        const void* table = nullptr;
+    };
+}
+#endif
+)#";
+
+// the live instances of a server class with --broadcast, kept in one vector sorted by client,
+// so a broadcast is a pass over it and the instances of a client a contiguous range.
+// Adding and removing shift the ones after, but they are rare next to sending.
+static constexpr std::string_view REGISTRY_DEFINITION = R"#(
+#ifndef HYPRWAYLAND_SCANNER_REGISTRY
+#define HYPRWAYLAND_SCANNER_REGISTRY
+namespace Hyprwayland {
+    template <typename T>
+    struct SInstance {
+        wl_client*   client   = nullptr;
+        wl_resource* resource = nullptr;
+        T*           object   = nullptr;
+        int          version  = 0;
+    };
+
+    template <typename T>
+    class CInstanceRegistry {
+      public:
+        constexpr CInstanceRegistry() = default;
+
+        void add(T* object, wl_client* client, wl_resource* resource) {
+            // std::less, as < doesn't order pointers to unrelated objects
+            const auto IT = std::upper_bound(instances.begin(), instances.end(), client,
+                                             [](wl_client* c, const SInstance<T>& instance) { return std::less<wl_client*>{}(c, instance.client); });
+            instances.insert(IT, SInstance<T>{client, resource, object, wl_resource_get_version(resource)});
+        }
+
+        void remove(T* object, wl_resource* resource) {
+            const auto RANGE = range(wl_resource_get_client(resource));
+            const auto IT    = std::find_if(RANGE.begin(), RANGE.end(), [object](const SInstance<T>& instance) { return instance.object == object; });
+            if (IT != RANGE.end())
+                instances.erase(instances.begin() + (&*IT - instances.data()));
+        }
+
+        // every instance, grouped by client
+        std::span<const SInstance<T>> all() const {
+            return instances;
+        }
+
+        // the instances of one client
+        std::span<const SInstance<T>> client(wl_client* client) const {
+            return range(client);
+        }
+
+        size_t size() const {
+            return instances.size();
+        }
+
+      private:
+        std::span<const SInstance<T>> range(wl_client* client) const {
+            const auto [FIRST, LAST] = std::equal_range(instances.begin(), instances.end(), SInstance<T>{client},
+                                                        [](const SInstance<T>& a, const SInstance<T>& b) { return std::less<wl_client*>{}(a.client, b.client); });
+            return {FIRST, LAST};
+        }
+
+        std::vector<SInstance<T>> instances;
+    };
+}
+#endif
+)#";
+
+// the counters of a message with --instrument, and the list of all of them for exporting.
+// Relaxed atomics only, so they can be bumped from anywhere and read while they are.
+// Defining HYPRWAYLAND_SCANNER_NO_INSTRUMENT for the whole build compiles the counting and timing out,
+// the stats are still there but stay at 0.
+static constexpr std::string_view INSTRUMENT_DEFINITION = R"#(
+#ifndef HYPRWAYLAND_SCANNER_INSTRUMENT
+#define HYPRWAYLAND_SCANNER_INSTRUMENT
+namespace Hyprwayland {
+    struct SMessageStats {
+        const char*           interface = nullptr;
+        const char*           message   = nullptr;
+        bool                  request   = false; // or an event
+        std::atomic<uint64_t> count{0};
+
+        // time spent in the handler of a received message. Bucket i counts the calls
+        // taking [2^(i-1), 2^i) ns, the last all longer ones
+        std::atomic<uint64_t> nanoseconds{0};
+        std::atomic<uint64_t> histogram[32] = {};
+    };
+
+    inline void countMessage(SMessageStats& stats) {
+#ifndef HYPRWAYLAND_SCANNER_NO_INSTRUMENT
+        stats.count.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    // counts a received message, and times its handler while alive
+    class CHandlerTimer {
+      public:
+#ifndef HYPRWAYLAND_SCANNER_NO_INSTRUMENT
+        CHandlerTimer(SMessageStats& stats) : stats(stats), start(now()) {
+            countMessage(stats);
+        }
+
+        ~CHandlerTimer() {
+            const uint64_t NS     = now() - start;
+            const size_t   BUCKET = std::bit_width(NS);
+            stats.nanoseconds.fetch_add(NS, std::memory_order_relaxed);
+            stats.histogram[BUCKET < 31 ? BUCKET : 31].fetch_add(1, std::memory_order_relaxed);
+        }
+
+      private:
+        static uint64_t now() {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+
+        SMessageStats& stats;
+        uint64_t       start = 0;
+#else
+        CHandlerTimer(SMessageStats&) {}
+#endif
+    };
+
+    // links the stats of a class into the list at startup
+    class CMessageStatsRegistration {
+      public:
+        template <size_t N>
+        CMessageStatsRegistration(SMessageStats (&stats)[N]) : stats(stats), count(N), next(head) {
+            head = this;
+        }
+
+        // calls fn with the stats of every message of every instrumented class
+        template <typename Fn>
+        static void forEach(Fn&& fn) {
+            for (auto* registration = head; registration; registration = registration->next) {
+                for (size_t i = 0; i < registration->count; ++i) {
+                    fn(static_cast<const SMessageStats&>(registration->stats[i]));
+                }
+            }
+        }
+
+      private:
+        SMessageStats*             stats = nullptr;
+        size_t                     count = 0;
+        CMessageStatsRegistration* next  = nullptr;
+
+        static inline CMessageStatsRegistration* head = nullptr;
+    };
+
+    template <typename Fn>
+    void forEachMessageStats(Fn&& fn) {
+        CMessageStatsRegistration::forEach(std::forward<Fn>(fn));
+    }
+}
+#endif
+)#";
+
+// the wire recorder with --record: a per-process ring of compact binary records of every message
+// the generated classes send and handle, overwriting the oldest once full. Off until started,
+// and then a record is a few stores. Not thread safe, like the classes.
+static constexpr std::string_view RECORDER_DEFINITION = R"#(
+#ifndef HYPRWAYLAND_SCANNER_RECORDER
+#define HYPRWAYLAND_SCANNER_RECORDER
+namespace Hyprwayland {
+    // followed by the args: ints, uints, fixeds, fds, object and new ids as 4 bytes,
+    // strings and arrays as their 4 byte size (~0 for null) and bytes. Strings keep their NUL.
+    struct SRecordHeader {
+        uint32_t size      = 0; // with the args
+        uint32_t object    = 0;
+        uint32_t interface = 0; // FNV-1a of its name
+        uint16_t opcode    = 0; // CRecorder::CREATED for a new object, with its version as the arg
+        uint8_t  request   = 0; // or an event
+        uint8_t  reserved  = 0;
+        uint64_t ns        = 0; // CLOCK_MONOTONIC
+    };
+
+    class CRecorder {
+      public:
+        static constexpr uint16_t CREATED = 0xFFFF;
+        static constexpr char     MAGIC[8] = {'H', 'W', 'S', 'R', 'E', 'C', '0', '1'};
+
+        // start recording into a ring of this many bytes, dropping what was recorded before
+        static void start(size_t bytes) {
+            ring.assign(bytes, 0);
+            head   = 0;
+            tail   = 0;
+            active = bytes > 0;
+        }
+
+        static void stop() {
+            active = false;
+        }
+
+        // what the ring holds, oldest first, behind MAGIC. Can be written to a file as is
+        static std::vector<uint8_t> dump() {
+            // never started, or without room
+            if (ring.empty())
+                return {std::begin(MAGIC), std::end(MAGIC)};
+
+            std::vector<uint8_t> out(sizeof(MAGIC) + (head - tail));
+            std::memcpy(out.data(), MAGIC, sizeof(MAGIC));
+            read(tail, out.data() + sizeof(MAGIC), head - tail);
+            return out;
+        }
+
+        template <typename... Args>
+        static void record(uint32_t interface, uint32_t object, uint16_t opcode, bool request, const Args&... args) {
+            SRecordHeader header{.size = (uint32_t)(sizeof(SRecordHeader) + (argSize(args) + ... + 0)), .object = object, .interface = interface, .opcode = opcode,
+                                 .request = request};
+            if (header.size > ring.size())
+                return;
+
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            header.ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+            // make room by dropping the oldest ones
+            while (head + header.size - tail > ring.size()) {
+                uint32_t size = 0;
+                read(tail, &size, sizeof(size));
+                tail += size;
+            }
+
+            write(&header, sizeof(header));
+            (put(args), ...);
+        }
+
+        // checked before recording anything, so an idle recorder costs a branch
+        static inline bool active = false;
+
+      private:
+        static size_t argSize(uint32_t) {
+            return 4;
+        }
+
+        static size_t argSize(int32_t) {
+            return 4;
+        }
+
+        static size_t argSize(const char* str) {
+            return 4 + (str ? std::strlen(str) + 1 : 0);
+        }
+
+        static size_t argSize(const wl_array* array) {
+            return 4 + (array ? array->size : 0);
+        }
+
+        static void put(uint32_t value) {
+            write(&value, 4);
+        }
+
+        static void put(int32_t value) {
+            write(&value, 4);
+        }
+
+        static void put(const char* str) {
+            const uint32_t SIZE = str ? std::strlen(str) + 1 : ~0U;
+            write(&SIZE, 4);
+            if (str)
+                write(str, SIZE);
+        }
+
+        static void put(const wl_array* array) {
+            const uint32_t SIZE = array ? array->size : ~0U;
+            write(&SIZE, 4);
+            if (array)
+                write(array->data, SIZE);
+        }
+
+        // head and tail only grow, the ring wraps them
+        static void write(const void* data, size_t size) {
+            if (size == 0)
+                return;
+
+            const size_t AT    = head % ring.size();
+            const size_t FIRST = size < ring.size() - AT ? size : ring.size() - AT;
+            std::memcpy(ring.data() + AT, data, FIRST);
+            std::memcpy(ring.data(), static_cast<const uint8_t*>(data) + FIRST, size - FIRST);
+            head += size;
+        }
+
+        static void read(size_t from, void* data, size_t size) {
+            if (size == 0)
+                return;
+
+            const size_t AT    = from % ring.size();
+            const size_t FIRST = size < ring.size() - AT ? size : ring.size() - AT;
+            std::memcpy(data, ring.data() + AT, FIRST);
+            std::memcpy(static_cast<uint8_t*>(data) + FIRST, ring.data(), size - FIRST);
+        }
+
+        static inline std::vector<uint8_t> ring;
+        static inline size_t               head = 0;
+        static inline size_t               tail = 0;
+    };
+}
+#endif
+)#";
+
+// the server side of --record: feeding a recording back to the handlers of the generated classes,
+// through the objects of a client with no one on the other end, see CReplay::run()
+static constexpr std::string_view REPLAY_DEFINITION = R"#(
+#ifndef HYPRWAYLAND_SCANNER_REPLAY
+#define HYPRWAYLAND_SCANNER_REPLAY
+namespace Hyprwayland {
+    // reads the args of a recorded request back in order, as the handlers take them
+    class CRecordReader {
+      public:
+        CRecordReader(wl_client* client, const SRecordHeader& header, const uint8_t* args) : client(client), header(header), cursor(args) {}
+
+        // the object the request is for, if it's still there
+        wl_resource* target() const {
+            return wl_client_get_object(client, header.object);
+        }
+
+        uint32_t u32() {
+            uint32_t value = 0;
+            std::memcpy(&value, cursor, 4);
+            cursor += 4;
+            return value;
+        }
+
+        int32_t i32() {
+            return (int32_t)u32();
+        }
+
+        // fds can't be recorded, handlers get -1
+        int32_t fd() {
+            u32();
+            return -1;
+        }
+
+        wl_resource* object() {
+            const auto ID = u32();
+            return ID ? wl_client_get_object(client, ID) : nullptr;
+        }
+
+        const char* string() {
+            const auto SIZE = u32();
+            if (SIZE == ~0U)
+                return nullptr;
+            const auto STR = (const char*)cursor;
+            cursor += SIZE;
+            return STR;
+        }
+
+        wl_array* array() {
+            const auto SIZE = u32();
+            if (SIZE == ~0U || arrayCount >= 4)
+                return nullptr;
+            arrays[arrayCount] = {.size = SIZE, .alloc = SIZE, .data = (void*)cursor};
+            cursor += SIZE;
+            return &arrays[arrayCount++];
+        }
+
+        wl_client* const     client = nullptr;
+        const SRecordHeader& header;
+
+      private:
+        const uint8_t* cursor = nullptr;
+        wl_array       arrays[4];
+        size_t         arrayCount = 0;
+    };
+
+    class CReplay {
+      public:
+        using FReplay = bool (*)(CRecordReader&);
+        using FCreate = void (*)(const char* interface, uint32_t version, uint32_t id, void* data);
+
+        // every generated class registers its replayer at startup
+        CReplay(uint32_t interface, const char* name, FReplay replay) : interface(interface), name(name), replay(replay), next(head) {
+            head = this;
+        }
+
+        // Feeds the requests of a recording to the handlers of client's objects, as if it sent them,
+        // and returns how many were. Objects the handlers create get the recorded ids, so later requests
+        // find them. Ones they don't, like those bound through the registry, go to create, which should
+        // do what binding does. Events are skipped.
+        static size_t run(wl_client* client, const std::vector<uint8_t>& recording, FCreate create = nullptr, void* data = nullptr) {
+            if (recording.size() < sizeof(CRecorder::MAGIC) || std::memcmp(recording.data(), CRecorder::MAGIC, sizeof(CRecorder::MAGIC)) != 0)
+                return 0;
+
+            size_t replayed = 0;
+            for (size_t at = sizeof(CRecorder::MAGIC); at + sizeof(SRecordHeader) <= recording.size();) {
+                SRecordHeader header;
+                std::memcpy(&header, recording.data() + at, sizeof(header));
+                if (header.size < sizeof(header) || at + header.size > recording.size())
+                    break;
+
+                const auto* args = recording.data() + at + sizeof(header);
+                at += header.size;
+
+                const CReplay* replayer = head;
+                while (replayer && replayer->interface != header.interface) {
+                    replayer = replayer->next;
+                }
+
+                if (!header.request || !replayer)
+                    continue;
+
+                CRecordReader reader(client, header, args);
+                if (header.opcode == CRecorder::CREATED) {
+                    const auto VERSION = reader.u32();
+                    if (!reader.target() && create)
+                        create(replayer->name, VERSION, header.object, data);
+                    continue;
+                }
+
+                if (replayer->replay(reader))
+                    replayed++;
+            }
+
+            return replayed;
+        }
+
+      private:
+        uint32_t       interface = 0;
+        const char*    name      = nullptr;
+        FReplay        replay    = nullptr;
+        const CReplay* next      = nullptr;
+
+        static inline const CReplay* head = nullptr;
+    };
+}
+#endif
+)#";
+
+// the includes F needs, and the support definitions
+static std::string handlerIncludes(const SOptions& options) {
+    std::vector<std::string_view> headers;
+    const auto                    add = [&headers](std::initializer_list<std::string_view> names) {
+        for (auto& name : names) {
+            if (std::find(headers.begin(), headers.end(), name) == headers.end())
+                headers.emplace_back(name);
+        }
+    };
+
+    if (options.delegate)
+        add({"cstring", "cstddef", "type_traits", "utility"});
+    else
+        add({"functional"});
+    if (options.pool)
+        add({"cstddef"});
+    if (options.broadcast && !options.clientCode)
+        add({"algorithm", "functional", "span", "vector"});
+    if (!options.coalesce.empty())
+        add({"vector"});
+    if (options.instrument)
+        add({"atomic", "bit", "cstddef", "ctime", "utility"});
+    if (options.record)
+        add({"cstddef", "cstring", "ctime", "vector"});
+
+    std::string includes;
+    for (auto& name : headers) {
+        includes += std::format("{}#include <{}>", (includes.empty() ? "" : "\n"), name);
+    }
+    return includes;
+}
+
+// what the generated code defines for itself, shared between all protocols
+static std::string supportDefinitions(const SOptions& options) {
+    std::string definitions;
+    if (options.delegate)
+        definitions += DELEGATE_DEFINITION;
+    if (options.pool)
+        definitions += POOL_DEFINITION;
+    if (options.staticDispatch)
+        definitions += STATIC_IMPLEMENTATION_DEFINITION;
+    if (options.broadcast && !options.clientCode)
+        definitions += REGISTRY_DEFINITION;
+    if (options.instrument)
+        definitions += INSTRUMENT_DEFINITION;
+    if (options.record)
+        definitions += RECORDER_DEFINITION;
+    if (options.record && !options.clientCode)
+        definitions += REPLAY_DEFINITION;
+    return definitions;
+}
+
+static std::string_view handlerType(const SOptions& options) {
+    return options.delegate ? "Hyprwayland::CDelegate" : "std::function";
+}
+
+static const char* resourceName(const SGenerationContext& ctx) {
+    return ctx.options.clientCode ? "wl_proxy" : "wl_resource";
+}
+
+static std::string_view sanitize(std::string_view in) {
+    if (in == "namespace")
+        return "namespace_";
+    if (in == "class")
+        return "class_";
+    if (in == "delete")
+        return "delete_";
+    if (in == "new")
+        return "new_";
+    return in;
+}
+
+static std::string argsToShort(const std::vector<SRequestArgument>& args, std::string_view since) {
+    std::string shortt{since};
+    for (auto& a : args) {
+        if (a.wlType == "int")
+            shortt += "i";
+        else if (a.wlType == "new_id") {
+            if (a.interface.empty())
+                shortt += "su";
+            shortt += "n";
+        } else if (a.wlType == "uint")
+            shortt += "u";
+        else if (a.wlType == "fixed")
+            shortt += "f";
+        else if (a.wlType == "string")
+            shortt += std::string(a.allowNull ? "?s" : "s");
+        else if (a.wlType == "object")
+            shortt += std::string(a.allowNull ? "?" : "") + "o";
+        else if (a.wlType == "array")
+            shortt += "a";
+        else if (a.wlType == "fd")
+            shortt += "h";
+        else
+            throw std::runtime_error("Unknown arg in argsToShort");
+    }
+    return shortt;
+}
+
+// with --marshal-array, messages are sent through a wl_argument array filled in place instead of varargs
+// libwayland has to walk by the signature. Only if the args map onto it one to one: a new_id without
+// an interface stands for three.
+static bool marshalsAsArray(const SGenerationContext& ctx, const SWaylandFunction& fn) {
+    return ctx.options.marshalArray && std::none_of(fn.args.begin(), fn.args.end(), [](const auto& arg) { return arg.wlType == "new_id" && arg.interface.empty(); });
+}
+
+// declares args for the values passed for fn's args, or nothing if there are none
+static std::string wlArgumentArray(const SWaylandFunction& fn, const std::vector<std::string>& values) {
+    if (fn.args.empty())
+        return "";
+
+    std::string array;
+    for (size_t i = 0; i < fn.args.size(); ++i) {
+        const auto& ARG   = fn.args[i];
+        const auto& VALUE = values[i];
+
+        if (ARG.wlType == "int")
+            array += ARG.enumName.empty() ? std::format("{{.i = {}}}, ", VALUE) : std::format("{{.i = (int32_t){}}}, ", VALUE);
+        else if (ARG.wlType == "uint")
+            array += ARG.enumName.empty() ? std::format("{{.u = {}}}, ", VALUE) : std::format("{{.u = (uint32_t){}}}, ", VALUE);
+        else if (ARG.wlType == "fixed")
+            array += std::format("{{.f = {}}}, ", VALUE);
+        else if (ARG.wlType == "string")
+            array += std::format("{{.s = {}}}, ", VALUE);
+        else if (ARG.wlType == "object" || ARG.wlType == "new_id")
+            array += VALUE == "nullptr" ? "{.o = nullptr}, " : std::format("{{.o = (wl_object*)({})}}, ", VALUE);
+        else if (ARG.wlType == "array")
+            array += std::format("{{.a = {}}}, ", VALUE);
+        else if (ARG.wlType == "fd")
+            array += std::format("{{.h = {}}}, ", VALUE);
+        else
+            throw std::runtime_error("Unknown arg in wlArgumentArray");
+    }
+
+    array.pop_back();
+    array.pop_back();
+
+    return std::format("    wl_argument args[] = {{{}}};\n", array);
+}
+
+// what sends fn with these values from a member: the wl_argument array with --marshal-array, and the call.
+// Clients can marshal through another proxy, like a wrapper putting the new_id on a queue
+static std::pair<std::string, std::string> sendCall(const SGenerationContext& ctx, const SWaylandFunction& fn, int opcode, const std::vector<std::string>& values,
+                                                    std::string_view proxy = "pResource") {
+    const bool ARRAY = marshalsAsArray(ctx, fn);
+    const auto ARGS  = fn.args.empty() ? "nullptr" : "args";
+
+    std::string argsN = ", ";
+    for (auto& value : values) {
+        argsN += std::format("{}, ", value);
+    }
+
+    argsN.pop_back();
+    argsN.pop_back();
+
+    if (!ctx.options.clientCode) {
+        if (ARRAY)
+            return {wlArgumentArray(fn, values), std::format("wl_resource_post_event_array(pResource, {}, {})", opcode, ARGS)};
+        return {"", std::format("wl_resource_post_event(pResource, {}{})", opcode, argsN)};
+    }
+
+    const auto INTERFACE = fn.newIdType.empty() ? std::string{"nullptr"} : std::format("&{}_interface", fn.newIdType);
+    const auto FLAGS     = fn.destructor ? "1" : "0";
+    if (ARRAY)
+        return {wlArgumentArray(fn, values),
+                std::format("wl_proxy_marshal_array_flags({}, {}, {}, wl_proxy_get_version(pResource), {}, {})", proxy, opcode, INTERFACE, FLAGS, ARGS)};
+    return {"", std::format("wl_proxy_marshal_flags({}, {}, {}, wl_proxy_get_version(pResource), {}{})", proxy, opcode, INTERFACE, FLAGS, argsN)};
+}
+
+// with --instrument, every class with messages has messageStats, its requests then events
+static bool instrumented(const SGenerationContext& ctx, const SInterface& iface) {
+    return ctx.options.instrument && !(iface.requests.empty() && iface.events.empty());
+}
+
+// the stats index of what the generated side sends or handles
+static size_t sentIndex(const SGenerationContext& ctx, const SInterface& iface, size_t i) {
+    return ctx.options.clientCode ? i : iface.requests.size() + i;
+}
+
+static size_t handledIndex(const SGenerationContext& ctx, const SInterface& iface, size_t i) {
+    return ctx.options.clientCode ? iface.requests.size() + i : i;
+}
+
+// the line counting a send, or timing a handler, at this indentation
+static std::string countLine(const SGenerationContext& ctx, const SInterface& iface, size_t i, std::string_view indent) {
+    if (!instrumented(ctx, iface))
+        return "";
+    return std::format("{}Hyprwayland::countMessage(messageStats[{}]);\n", indent, sentIndex(ctx, iface, i));
+}
+
+static std::string timerLine(const SGenerationContext& ctx, const SInterface& iface, std::string_view className, size_t i, std::string_view indent) {
+    if (!instrumented(ctx, iface))
+        return "";
+    return std::format("{}const Hyprwayland::CHandlerTimer TIMER{{{}::messageStats[{}]}};\n", indent, className, handledIndex(ctx, iface, i));
+}
+
+// FNV-1a, how recordings refer to interfaces
+static uint32_t interfaceHash(std::string_view name) {
+    uint32_t hash = 0x811c9dc5;
+    for (const char c : name) {
+        hash ^= (unsigned char)c;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// --broadcast helpers go to events that mean the same to every client: no objects, which belong
+// to one, and no new_ids
+static bool hasBroadcast(const SGenerationContext& ctx, const SWaylandFunction& ev) {
+    return ctx.options.broadcast && !ctx.options.clientCode &&
+        std::none_of(ev.args.begin(), ev.args.end(), [](const auto& arg) { return arg.wlType == "object" || arg.wlType == "new_id"; });
+}
+
+// --coalesce: whether sends of fn are held back until flushCoalesced(), keeping the latest args.
+// Those are kept until then, so they have to be values.
+static bool coalesces(const SGenerationContext& ctx, const SInterface& iface, const SWaylandFunction& fn) {
+    if (std::find(ctx.options.coalesce.begin(), ctx.options.coalesce.end(), std::format("{}.{}", iface.name, fn.name)) == ctx.options.coalesce.end())
+        return false;
+
+    if (fn.destructor || std::any_of(fn.args.begin(), fn.args.end(), [](const auto& arg) { return arg.wlType != "int" && arg.wlType != "uint" && arg.wlType != "fixed"; }))
+        throw std::runtime_error(std::format("can't coalesce {}.{}, only messages with int, uint and fixed args can be", iface.name, fn.name));
+
+    return true;
+}
+
+// with --event-queues, client objects can be put on a wl_event_queue of their own
+static bool eventQueues(const SGenerationContext& ctx) {
+    return ctx.options.eventQueues && ctx.options.clientCode;
+}
+
+// new_id senders then get an overload creating the object on a given queue. Not destructors,
+// as the wrapper it's marshalled through can't be destroyed by the send
+static bool createsOnQueue(const SGenerationContext& ctx, const SWaylandFunction& fn) {
+    return eventQueues(ctx) && !fn.newIdType.empty() && !fn.destructor;
+}
+
+static bool hasCoalesced(const SGenerationContext& ctx, const SInterface& iface) {
+    const auto& SENT = ctx.options.clientCode ? iface.requests : iface.events;
+    return std::any_of(SENT.begin(), SENT.end(), [&](const auto& fn) { return coalesces(ctx, iface, fn); });
+}
+
+std::string HyprwaylandScanner::camelize(std::string_view snake) {
+    std::string result = "";
+    for (size_t i = 0; i < snake.length(); ++i) {
+        if (snake[i] == '_' && i != 0 && i + 1 < snake.length() && snake[i + 1] != '_') {
+            result += ::toupper(snake[i + 1]);
+            i++;
+            continue;
+        }
+
+        result += snake[i];
+    }
+
+    return result;
+}
+
+static std::string resolveCType(const SGenerationContext& ctx, const SRequestArgument& arg, bool event /* events pass iface ptrs, requests ids */, bool ignoreTypes /* for dangerous */) {
+    if (arg.wlType == "uint" || arg.wlType == "new_id") {
+        if (arg.enumName.empty() && arg.interface.empty())
+            return "uint32_t";
+
+        // enum
+        if (!arg.enumName.empty()) {
+            const auto IT = ctx.XMLDATA.enumIndex.find(arg.enumName);
+            return IT != ctx.XMLDATA.enumIndex.end() ? ctx.XMLDATA.enums[IT->second].name : "uint32_t";
+        }
+
+        if (!event && ctx.options.clientCode && arg.wlType == "new_id")
+            return "wl_proxy*";
+
+        // iface
+        if (!arg.interface.empty() && event) {
+            if (ctx.XMLDATA.ifaceIndex.contains(arg.interface))
+                return camelize(std::format("{}{}*", ctx.options.clientCode ? "CC_" : "C_", arg.interface));
+            return std::string{resourceName(ctx)} + "*";
+        }
+
+        return "uint32_t";
+    }
+    if (arg.wlType == "object") {
+        if (!arg.interface.empty() && event && !ignoreTypes && ctx.XMLDATA.ifaceIndex.contains(arg.interface))
+            return camelize(std::format("{}{}*", ctx.options.clientCode ? "CC_" : "C_", arg.interface));
+        return std::string{resourceName(ctx)} + "*";
+    }
+    if (arg.wlType == "int" || arg.wlType == "fd")
+        return "int32_t";
+    if (arg.wlType == "fixed")
+        return "wl_fixed_t";
+    if (arg.wlType == "array")
+        return "wl_array*";
+    if (arg.wlType == "string")
+        return "const char*";
+    throw std::runtime_error("unknown wp type");
+    return "";
+}
+
+static const std::string& WPTypeToCType(const SGenerationContext& ctx, const SRequestArgument& arg, bool event /* events pass iface ptrs, requests ids */, bool ignoreTypes = false /* for dangerous */) {
+    if (!event)
+        return arg.cTypeRequest;
+    return ignoreTypes ? arg.cTypeEventRaw : arg.cTypeEvent;
+}
+
+// the args of a message as CRecorder::record() takes them: ids for objects, enums as values.
+// Like the handlers and senders, without the new_ids the client gets back as proxies.
+static std::string recordArgs(const SGenerationContext& ctx, const SWaylandFunction& fn, bool event, bool raw, std::string_view prefix = "") {
+    const auto  ID = ctx.options.clientCode ? "wl_proxy_get_id" : "wl_resource_get_id";
+
+    std::string args;
+    for (auto& arg : fn.args) {
+        if (arg.newType)
+            continue;
+
+        const auto& TYPE = WPTypeToCType(ctx, arg, event, raw);
+        const auto  NAME = std::format("{}{}", prefix, arg.name);
+        if (TYPE == "wl_resource*" || TYPE == "wl_proxy*")
+            args += std::format(", {} ? {}({}) : 0", NAME, ID, NAME);
+        else if (TYPE.starts_with("C") && TYPE.ends_with("*"))
+            args += std::format(", {} ? {}({}->pResource) : 0", NAME, ID, NAME);
+        else if (TYPE != "uint32_t" && (arg.wlType == "uint" || arg.wlType == "int"))
+            args += std::format(", ({}){}", arg.wlType == "int" ? "int32_t" : "uint32_t", NAME);
+        else
+            args += std::format(", {}", NAME);
+    }
+
+    return args;
+}
+
+// the lines recording a message on object, at this indentation
+static std::string recordLine(const SGenerationContext& ctx, const SInterface& iface, std::string_view object, size_t opcode, bool request, const std::string& args,
+                              std::string_view indent) {
+    if (!ctx.options.record)
+        return "";
+    return std::format("{}if (Hyprwayland::CRecorder::active)\n{}    Hyprwayland::CRecorder::record({:#x}, {}, {}, {}{});\n", indent, indent, interfaceHash(iface.name), object, opcode,
+                       request, args);
+}
+
+// resolve all types and signatures once, instead of at every use during generation
+void HyprwaylandScanner::resolveTypes(SGenerationContext& ctx) {
+    for (size_t i = 0; i < ctx.XMLDATA.enums.size(); ++i) {
+        ctx.XMLDATA.enumIndex.emplace(ctx.XMLDATA.enums[i].nameOriginal, i);
+    }
+
+    for (size_t i = 0; i < ctx.XMLDATA.ifaces.size(); ++i) {
+        ctx.XMLDATA.ifaceIndex.emplace(ctx.XMLDATA.ifaces[i].name, i);
+    }
+
+    for (auto& iface : ctx.XMLDATA.ifaces) {
+        for (auto* fns : {&iface.requests, &iface.events}) {
+            for (auto& fn : *fns) {
+                for (auto& arg : fn.args) {
+                    arg.cTypeRequest  = resolveCType(ctx, arg, false, false);
+                    arg.cTypeEvent    = resolveCType(ctx, arg, true, false);
+                    arg.cTypeEventRaw = resolveCType(ctx, arg, true, true);
+                }
+
+                fn.signature = argsToShort(fn.args, fn.since);
+            }
+        }
+    }
+}
+
+void HyprwaylandScanner::parseXML(SGenerationContext& ctx, pugi::xml_document& doc) {
+
+    for (auto& ge : doc.child("protocol").children("enum")) {
+        SEnum enum_;
+        enum_.nameOriginal = ge.attribute("name").as_string();
+        enum_.name         = ctx.options.waylandEnums ? std::format("enum {}_{}", ctx.PROTO_DATA.name, enum_.nameOriginal) : camelize(std::format("{}_{}", ctx.PROTO_DATA.name, enum_.nameOriginal));
+        for (auto& entry : ge.children("entry")) {
+            auto VALUENAME = std::format("{}_{}", enum_.nameOriginal, entry.attribute("name").as_string());
+            std::transform(VALUENAME.begin(), VALUENAME.end(), VALUENAME.begin(), ::toupper);
+            enum_.values.emplace_back(std::make_pair<>(VALUENAME, entry.attribute("value").as_int()));
+        }
+        ctx.XMLDATA.enums.emplace_back(std::move(enum_));
+    }
+
+    for (auto& iface : doc.child("protocol").children("interface")) {
+        SInterface ifc;
+        ifc.name    = iface.attribute("name").as_string();
+        ifc.version = iface.attribute("version").as_int();
+
+        for (auto& en : iface.children("enum")) {
+            SEnum enum_;
+            enum_.nameOriginal = en.attribute("name").as_string();
+            enum_.name         = ctx.options.waylandEnums ? std::format("enum {}_{}", ifc.name, enum_.nameOriginal) : camelize(std::format("{}_{}", ifc.name, enum_.nameOriginal));
+            for (auto& entry : en.children("entry")) {
+                auto VALUENAME = std::format("{}_{}_{}", ifc.name, enum_.nameOriginal, entry.attribute("name").as_string());
+                std::transform(VALUENAME.begin(), VALUENAME.end(), VALUENAME.begin(), ::toupper);
+                enum_.values.emplace_back(std::make_pair<>(VALUENAME, entry.attribute("value").as_int()));
+            }
+            ctx.XMLDATA.enums.emplace_back(std::move(enum_));
+        }
+
+        for (auto& rq : iface.children("request")) {
+            SWaylandFunction srq;
+            srq.name       = rq.attribute("name").as_string();
+            srq.since      = rq.attribute("since").as_string();
+            srq.destructor = rq.attribute("type").as_string() == std::string{"destructor"};
+
+            for (auto& arg : rq.children("arg")) {
+                SRequestArgument sargm;
+                if (arg.attribute("type").as_string() == std::string{"new_id"} && ctx.options.clientCode)
+                    srq.newIdType = arg.attribute("interface").as_string();
+
+                sargm.newType   = arg.attribute("type").as_string() == std::string{"new_id"} && ctx.options.clientCode;
+                sargm.name      = sanitize(arg.attribute("name").as_string());
+                sargm.wlType    = arg.attribute("type").as_string();
+                sargm.interface = arg.attribute("interface").as_string();
+                sargm.enumName  = arg.attribute("enum").as_string();
+                sargm.allowNull = arg.attribute("allow-null").as_string() == std::string{"true"};
+
+                srq.args.emplace_back(std::move(sargm));
+            }
+
+            ifc.requests.emplace_back(std::move(srq));
+        }
+
+        for (auto& ev : iface.children("event")) {
+            SWaylandFunction sev;
+            sev.name       = ev.attribute("name").as_string();
+            sev.since      = ev.attribute("since").as_string();
+            sev.destructor = ev.attribute("type").as_string() == std::string{"destructor"};
+
+            for (auto& arg : ev.children("arg")) {
+                SRequestArgument sargm;
+                sargm.name      = sanitize(arg.attribute("name").as_string());
+                sargm.interface = arg.attribute("interface").as_string();
+                sargm.wlType    = arg.attribute("type").as_string();
+                sargm.enumName  = arg.attribute("enum").as_string();
+                sargm.allowNull = arg.attribute("allow-null").as_string() == std::string{"true"};
+
+                sev.args.emplace_back(std::move(sargm));
+            }
+
+            ifc.events.emplace_back(std::move(sev));
+        }
+
+        ctx.XMLDATA.ifaces.emplace_back(std::move(ifc));
+    }
+}
+
+// the function libwayland calls for a request (server) or an event (client)
+static std::string handlerSignature(const SGenerationContext& ctx, const SInterface& iface, const SWaylandFunction& rq) {
+    const auto  REQUEST_NAME = camelize(std::format("_C_{}_{}", iface.name, rq.name));
+
+    std::string argsC = ", ";
+    for (auto& arg : rq.args) {
+        if (arg.newType)
+            continue;
+        argsC += std::format("{} {}, ", WPTypeToCType(ctx, arg, false), arg.name);
+    }
+
+    argsC.pop_back();
+    argsC.pop_back();
+
+    if (ctx.options.clientCode)
+        return std::format("void {}(void* data, void* resource{})", REQUEST_NAME, argsC);
+    return std::format("void {}(wl_client* client, wl_resource* resource{})", REQUEST_NAME, argsC);
+}
+
+static std::string destroyListenerSignature(const std::string& className) {
+    return std::format("void _{}__DestroyListener(wl_listener* l, void* d)", className);
+}
+
+// enums, forward declarations of all classes and the wl_interface externs
+static void writeDeclarations(const SGenerationContext& ctx, CWriter& out, bool externs = true) {
+    // parse all enums
+    if (!ctx.options.waylandEnums) {
+        for (auto& en : ctx.XMLDATA.enums) {
+            out.format("enum {} : uint32_t {{\n", en.name);
+            for (auto& [k, v] : en.values) {
+                out.format("    {} = {},\n", k, v);
+            }
+            out += "};\n\n";
+        }
+    }
+
+    // fw declare all classes, once each. A module owns whatever it declares, so it
+    // leaves out classes of other protocols, they're only ever passed as wl_resource*
+    std::unordered_set<std::string> declaredClasses;
+    const auto                      declareClass = [&](std::string_view name) {
+        if (ctx.options.module && !ctx.XMLDATA.ifaceIndex.contains(name))
+            return;
+
+        const auto CLASS_NAME = camelize(std::format("{}{}", ctx.options.clientCode ? "CC_" : "C_", name));
+        if (declaredClasses.emplace(CLASS_NAME).second)
+            out.format("\nclass {};", CLASS_NAME);
+    };
+
+    for (auto& iface : ctx.XMLDATA.ifaces) {
+        declareClass(iface.name);
+
+        for (auto& rq : iface.requests) {
+            for (auto& arg : rq.args) {
+                if (!arg.interface.empty())
+                    declareClass(arg.interface);
+            }
+        }
+
+        for (auto& rq : iface.events) {
+            for (auto& arg : rq.args) {
+                if (!arg.interface.empty())
+                    declareClass(arg.interface);
+            }
+        }
+    }
+
+    if (!externs) {
+        out += "\n";
+        return;
+    }
+
+    out += "\n\n#ifndef HYPRWAYLAND_SCANNER_NO_INTERFACES\n";
+
+    for (auto& iface : ctx.XMLDATA.ifaces) {
+        const auto IFACE_WL_NAME       = std::format("{}_interface", iface.name);
+        const auto IFACE_WL_NAME_CAMEL = camelize(IFACE_WL_NAME);
+
+        out.format("extern const wl_interface {};\n", IFACE_WL_NAME, IFACE_WL_NAME_CAMEL, IFACE_WL_NAME);
+    }
+
+    out += "\n#endif\n";
+}
+
+// lightweight header for TUs that only need to name the classes
+void HyprwaylandScanner::parseFwdHeader(SGenerationContext& ctx) {
+    ctx.FWD_HEADER += R"#(#pragma once
+
+#include <cstdint>
+
+struct wl_interface;
+
+)#";
+
+    writeDeclarations(ctx, ctx.FWD_HEADER);
+}
+
+// A CRTP template over the class for --static-dispatch. Its thunks call the implementing class
+// directly instead of going through the handler slots, so the calls can be inlined.
+static void writeStaticDispatch(SGenerationContext& ctx, const SInterface& iface) {
+    const auto  CLASS_NAME = camelize(std::format("{}{}", ctx.options.clientCode ? "CC_" : "C_", iface.name));
+    const auto& HANDLERS   = ctx.options.clientCode ? iface.events : iface.requests;
+
+    ctx.HEADER.format("// static dispatch: derive as class CImpl : public {}Static<CImpl> and implement\n"
+                      "// these as members. They are called directly, the setX() handlers are not.\n",
+                      CLASS_NAME);
+
+    // the members Impl has to have, their thunks and the implementation struct
+    std::string members, thunks, fields, implementation;
+    for (size_t i = 0; i < HANDLERS.size(); ++i) {
+        const auto& rq   = HANDLERS[i];
+        const auto  NAME = camelize(rq.name);
+
+        std::string params, paramTypes, args;
+        for (auto& arg : rq.args) {
+            if (arg.newType)
+                continue;
+            const auto& TYPE = WPTypeToCType(ctx, arg, false);
+            params += std::format(", {} {}", TYPE, arg.name);
+            paramTypes += std::format(", {}", TYPE);
+            args += std::format(", {}", arg.name);
+        }
+
+        members += std::format("//   void {}({});\n", NAME, params.empty() ? "" : params.substr(2));
+
+        if (ctx.options.clientCode)
+            thunks += std::format(R"#(
+    static void _{}(void* data, void* resource{}) {{
+{}        if (const auto PO = ({}*)data)
+            static_cast<Impl*>(PO)->{}({});
+    }}
+)#",
+                                  NAME, params, timerLine(ctx, iface, CLASS_NAME, i, "        "), CLASS_NAME, NAME, args.empty() ? "" : args.substr(2));
+        else
+            thunks += std::format(R"#(
+    static void _{}(wl_client* client, wl_resource* resource{}) {{
+{}        if (const auto PO = ({}*)wl_resource_get_user_data(resource))
+            static_cast<Impl*>(PO)->{}({});
+    }}
+)#",
+                                  NAME, params, timerLine(ctx, iface, CLASS_NAME, i, "        "), CLASS_NAME, NAME, args.empty() ? "" : args.substr(2));
+
+        fields += std::format("        void (*{})({}{});\n", NAME, ctx.options.clientCode ? "void*, void*" : "wl_client*, wl_resource*", paramTypes);
+        implementation += std::format("&_{}, ", NAME);
+    }
+
+    if (!implementation.empty()) {
+        implementation.pop_back();
+        implementation.pop_back();
+    }
+
+    ctx.HEADER += members;
+    ctx.HEADER.format(R"#(template <typename Impl>
+class {}Static : public {} {{
+  public:
+    {}Static({}) : {}({}, {{&IMPLEMENTATION}}) {{}}{}{}
+
+  private:{}{}
+    // laid out like the array of function pointers libwayland expects
+    struct SImplementation {{
+{}    }};
+
+    static constexpr SImplementation IMPLEMENTATION = {{{}}};
+}};
+
+)#",
+                      CLASS_NAME, CLASS_NAME, CLASS_NAME, (ctx.options.clientCode ? "wl_proxy* resource" : "wl_client* client, uint32_t version, uint32_t id"), CLASS_NAME,
+                      (ctx.options.clientCode ? "resource" : "client, version, id"),
+                      (eventQueues(ctx) ?
+                           std::format("\n    {}Static(wl_proxy* resource, wl_event_queue* queue) : {}(resource, queue, {{&IMPLEMENTATION}}) {{}}", CLASS_NAME, CLASS_NAME) :
+                           ""),
+                      (ctx.options.pool ? STATIC_POOL_PUBLIC : ""), (ctx.options.pool ? STATIC_POOL_PRIVATE : ""), thunks, fields, implementation);
+}
+
+void HyprwaylandScanner::parseHeader(SGenerationContext& ctx) {
+
+    if (ctx.options.module) {
+        // exported from the module, see writeModule()
+        ctx.HEADER += "export {\n";
+        writeDeclarations(ctx, ctx.HEADER, false);
+        ctx.HEADER += "}\n\n// the classes befriend these, as they reach into the private parts\n";
+
+        for (auto& iface : ctx.XMLDATA.ifaces) {
+            for (auto& rq : (ctx.options.clientCode ? iface.events : iface.requests)) {
+                ctx.HEADER.format("{};\n", handlerSignature(ctx, iface, rq));
+            }
+
+            if (!ctx.options.clientCode)
+                ctx.HEADER.format("{};\n", destroyListenerSignature(camelize(std::format("C_{}", iface.name))));
+        }
+
+        ctx.HEADER += "\nexport {\n";
+    } else {
+        // add some boilerplate
+        ctx.HEADER.format(R"#(#pragma once
+
+{}
+#include <cstdint>
+#include <string>
+{}{}
+
+#define F {}
+
+{}
+
+)#",
+                          handlerIncludes(ctx.options), (ctx.options.clientCode ? "#include <wayland-client.h>" : "#include <wayland-server.h>"),
+                          supportDefinitions(ctx.options), handlerType(ctx.options),
+                          (ctx.options.clientCode ? "struct wl_proxy;" : "struct wl_client;\nstruct wl_resource;"));
+
+        if (ctx.options.fwdHeader)
+            ctx.HEADER.format("#include \"{}-fwd.hpp\"\n", ctx.PROTO_DATA.fileName);
+        else
+            writeDeclarations(ctx, ctx.HEADER);
+    }
+
+    for (auto& iface : ctx.XMLDATA.ifaces) {
+        const auto IFACE_NAME_CAMEL       = camelize(iface.name);
+        const auto IFACE_CLASS_NAME_CAMEL = camelize(std::format("{}{}", ctx.options.clientCode ? "CC_" : "C_", iface.name));
+
+        if (!ctx.options.clientCode) {
+            ctx.HEADER.format(R"#(
+struct {}DestroyWrapper {{
+    wl_listener listener;
+    {}* parent = nullptr;
+}};
+            )#",
+                              IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
+        }
+
+        // begin the class
+        ctx.HEADER.format(R"#(
+
+class {} {{
+  public:
+    {}({});{}
+    ~{}();
+
+)#",
+                        IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, (ctx.options.clientCode ? "wl_proxy*" : "wl_client* client, uint32_t version, uint32_t id"),
+                        (eventQueues(ctx) ? std::format("\n    // with its events on queue. Create it there with a send overload taking the queue,\n    // or events "
+                                                              "sent before this went to the old one\n    {}(wl_proxy*, wl_event_queue* queue);",
+                                                              IFACE_CLASS_NAME_CAMEL) :
+                                                  ""),
+                        IFACE_CLASS_NAME_CAMEL);
+
+        if (ctx.options.pool) {
+            ctx.HEADER.format(R"#(    // recycled through a per-class Hyprwayland::CPool instead of the heap.
+    // Derived classes of another size go to the heap as usual{}
+    static void* operator new(size_t size);
+    static void  operator delete(void* p, size_t size);
+
+    // how the pool is doing, and making room up front
+    static const Hyprwayland::SPoolStats& poolStats();
+    static void                           reservePool(size_t count);
+
+)#",
+                              (ctx.options.staticDispatch ? std::format(",\n    // but {}Static<Impl> has a pool for its Impl", IFACE_CLASS_NAME_CAMEL) : ""));
+        }
+
+        if (!ctx.options.clientCode) {
+            ctx.HEADER.format(R"#(
+    // set a listener for when this resource is _being_ destroyed
+    void setOnDestroy(F<void({}*)> &&handler) {{
+        onDestroy = std::move(handler);
+    }}
+
+    // set the data for this resource
+    void setData(void* data) {{
+        pData = data;
+    }}
+
+    // get the data for this resource
+    void* data() {{
+        return pData;
+    }}
+
+    // get the raw wl_resource ptr
+    wl_resource* resource() {{
+        return pResource;
+    }}
+
+    // get the client
+    wl_client* client() {{
+        return wl_resource_get_client(pResource);
+    }}
+
+    // send an error
+    void error(uint32_t error, const std::string& message) {{
+        wl_resource_post_error(pResource, error, "%s", message.c_str());
+    }}
+
+    // send out of memory
+    void noMemory() {{
+        wl_resource_post_no_memory(pResource);
+    }}
+
+    // get the resource version
+    int version() {{
+        return wl_resource_get_version(pResource);
+    }}
+            )#",
+                                  IFACE_CLASS_NAME_CAMEL);
+        } else {
+            ctx.HEADER += R"#(
+    // set the data for this resource
+    void setData(void* data) {{
+        pData = data;
+    }}
+
+    // get the data for this resource
+    void* data() {{
+        return pData;
+    }}
+
+    // get the raw wl_resource (wl_proxy) ptr
+    wl_proxy* resource() {{
+        return pResource;
+    }}
+
+    // get the raw wl_proxy ptr
+    wl_proxy* proxy() {{
+        return pResource;
+    }}
+
+    // get the resource version
+    int version() {{
+        return wl_proxy_get_version(pResource);
+    }}
+            )#";
+
+            if (eventQueues(ctx))
+                ctx.HEADER += R"#(
+    // dispatch its events on queue from now on, nullptr for the default queue.
+    // Events already queued stay where they are
+    void setQueue(wl_event_queue* queue) {
+        if (pResource)
+            wl_proxy_set_queue(pResource, queue);
+    }
+            )#";
+        }
+
+        // add all setters for requests
+        ctx.HEADER += "\n    // --------------- Requests --------------- //\n\n";
+
+        for (auto& rq : (ctx.options.clientCode ? iface.events : iface.requests)) {
+
+            std::string args = ", ";
+            for (auto& arg : rq.args) {
+                if (arg.newType)
+                    continue;
+                args += WPTypeToCType(ctx, arg, false) + ", ";
+            }
+
+            args.pop_back();
+            args.pop_back();
+
+            ctx.HEADER.format("    void {}(F<void({}*{})> &&handler);\n", camelize(std::format("set_{}", rq.name)), IFACE_CLASS_NAME_CAMEL, args);
+        }
+
+        // start events
+
+        ctx.HEADER += "\n    // --------------- Events --------------- //\n\n";
+
+        for (auto& ev : (!ctx.options.clientCode ? iface.events : iface.requests)) {
+            std::string args = "";
+            for (auto& arg : ev.args) {
+                if (arg.newType)
+                    continue;
+                args += WPTypeToCType(ctx, arg, true) + ", ";
+            }
+
+            if (!args.empty()) {
+                args.pop_back();
+                args.pop_back();
+            }
+
+            ctx.HEADER.format("    {} {}({});\n", ev.newIdType.empty() ? "void" : "wl_proxy*", camelize(std::format("send_{}", ev.name)), args);
+            if (createsOnQueue(ctx, ev))
+                ctx.HEADER.format("    wl_proxy* {}({}{}wl_event_queue* queue);\n", camelize(std::format("send_{}", ev.name)), args, (args.empty() ? "" : ", "));
+        }
+
+        // dangerous ones
+        if (!ctx.options.clientCode) {
+            for (auto& ev : (!ctx.options.clientCode ? iface.events : iface.requests)) {
+                std::string args = "";
+                for (auto& arg : ev.args) {
+                    if (arg.newType)
+                        continue;
+                    args += WPTypeToCType(ctx, arg, true, true) + ", ";
+                }
+
+                if (!args.empty()) {
+                    args.pop_back();
+                    args.pop_back();
+                }
+
+                ctx.HEADER.format("    void {}({});\n", camelize(std::format("send_{}_raw", ev.name)), args);
+            }
+        }
+
+        // end events
+
+        const bool COALESCED = hasCoalesced(ctx, iface);
+        if (COALESCED) {
+            ctx.HEADER += R"#(
+    // send the latest of each coalesced event still pending, of this object or of all of them.
+    // Other events flush them first, so they stay ahead of those. Among themselves, the pending ones
+    // go out in the order the protocol declares them, not the one they were sent in.
+    void        flushCoalesced();
+    static void flushAllCoalesced();
+)#";
+        }
+
+        if (instrumented(ctx, iface))
+            ctx.HEADER.format("\n    // counters of the requests, then the events, see Hyprwayland::forEachMessageStats()\n    static Hyprwayland::SMessageStats messageStats[{}];\n",
+                              iface.requests.size() + iface.events.size());
+
+        if (ctx.options.broadcast && !ctx.options.clientCode) {
+            ctx.HEADER.format("\n    // --------------- Broadcasts --------------- //\n\n    // every live instance, grouped by client\n"
+                              "    static const Hyprwayland::CInstanceRegistry<{}>& instances();\n",
+                              IFACE_CLASS_NAME_CAMEL);
+
+            std::string broadcasts;
+            for (auto& ev : iface.events) {
+                if (!hasBroadcast(ctx, ev))
+                    continue;
+
+                std::string args = "";
+                for (auto& arg : ev.args) {
+                    args += WPTypeToCType(ctx, arg, true) + ", ";
+                }
+
+                if (!args.empty()) {
+                    args.pop_back();
+                    args.pop_back();
+                }
+
+                const auto NAME = camelize(std::format("broadcast_{}", ev.name));
+                broadcasts += std::format("    static void {}({});\n    static void {}(wl_client* client{}{});\n", NAME, args, NAME, (args.empty() ? "" : ", "), args);
+            }
+
+            if (!broadcasts.empty())
+                ctx.HEADER.format("\n    // send to every instance having the event, or every one of a client\n{}", broadcasts);
+        }
+
+        if (ctx.options.staticDispatch) {
+            ctx.HEADER.format("\n  protected:\n    // for static dispatch, see {}Static\n    {}({}, Hyprwayland::SStaticImplementation implementation);\n", IFACE_CLASS_NAME_CAMEL,
+                              IFACE_CLASS_NAME_CAMEL, (ctx.options.clientCode ? "wl_proxy* resource" : "wl_client* client, uint32_t version, uint32_t id"));
+            if (eventQueues(ctx))
+                ctx.HEADER.format("    {}(wl_proxy* resource, wl_event_queue* queue, Hyprwayland::SStaticImplementation implementation);\n", IFACE_CLASS_NAME_CAMEL);
+        }
+
+        // start private section
+        ctx.HEADER += "\n  private:\n";
+
+        if (ctx.options.module) {
+            for (auto& rq : (ctx.options.clientCode ? iface.events : iface.requests)) {
+                ctx.HEADER.format("    friend {};\n", handlerSignature(ctx, iface, rq));
+            }
+
+            if (!ctx.options.clientCode)
+                ctx.HEADER.format("    friend {};\n", destroyListenerSignature(IFACE_CLASS_NAME_CAMEL));
+
+            // senders of the other classes take our resource
+            for (auto& other : ctx.XMLDATA.ifaces) {
+                if (&other != &iface)
+                    ctx.HEADER.format("    friend class {};\n", camelize(std::format("{}{}", ctx.options.clientCode ? "CC_" : "C_", other.name)));
+            }
+
+            ctx.HEADER += "\n";
+        }
+
+        // start requests storage
+        ctx.HEADER += "    struct {\n";
+
+        for (auto& rq : (ctx.options.clientCode ? iface.events : iface.requests)) {
+
+            std::string args = ", ";
+            for (auto& arg : rq.args) {
+                if (arg.newType)
+                    continue;
+                args += WPTypeToCType(ctx, arg, false) + ", ";
+            }
+
+            if (!args.empty()) {
+                args.pop_back();
+                args.pop_back();
+            }
+
+            ctx.HEADER.format("        F<void({}*{})> {};\n", IFACE_CLASS_NAME_CAMEL, args, camelize(rq.name));
+        }
+
+        // end requests storage
+        ctx.HEADER += "    } requests;\n";
+
+        if (COALESCED) {
+            ctx.HEADER += "\n    // the latest args of coalesced events, until flushed\n    struct {\n";
+
+            for (auto& ev : (!ctx.options.clientCode ? iface.events : iface.requests)) {
+                if (!coalesces(ctx, iface, ev))
+                    continue;
+
+                ctx.HEADER += "        struct {\n            bool pending = false;\n";
+                for (auto& arg : ev.args) {
+                    ctx.HEADER.format("            {} {};\n", WPTypeToCType(ctx, arg, true), arg.name);
+                }
+                ctx.HEADER.format("        }} {};\n", camelize(ev.name));
+            }
+
+            ctx.HEADER += "    } coalesced;\n\n    bool coalescedQueued = false;\n";
+        }
+
+        // constant resource stuff
+        if (!ctx.options.clientCode) {
+            ctx.HEADER.format(R"#(
+    void onDestroyCalled();
+
+    F<void({}*)> onDestroy;
+
+    wl_resource* pResource = nullptr;
+
+    {}DestroyWrapper resourceDestroyListener;
+
+    void* pData = nullptr;)#",
+                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
+        } else {
+            if (eventQueues(ctx))
+                ctx.HEADER += "\n    void addListener(const void* implementation);\n";
+
+            ctx.HEADER += R"#(
+    wl_proxy* pResource = nullptr;
+
+    bool destroyed = false;
+
+    void* pData = nullptr;)#";
+        }
+
+        ctx.HEADER += "\n};\n\n";
+
+        if (ctx.options.staticDispatch)
+            writeStaticDispatch(ctx, iface);
+    }
+
+    if (ctx.options.module)
+        ctx.HEADER += "\n} // export\n";
+    else
+        ctx.HEADER += "\n\n#undef F\n";
+}
+
+// names of all wl_interfaces a protocol defines or references, in order of first use
+std::vector<std::string> HyprwaylandScanner::referencedInterfaces(const SGenerationContext& ctx) {
+    std::vector<std::string>        ifaces;
+    std::unordered_set<std::string> seen;
+
+    for (auto& iface : ctx.XMLDATA.ifaces) {
+        if (seen.emplace(iface.name).second)
+            ifaces.emplace_back(iface.name);
+    }
+
+    for (auto& iface : ctx.XMLDATA.ifaces) {
+        // do all referenced too
+        for (auto* fns : {&iface.requests, &iface.events}) {
+            for (auto& fn : *fns) {
+                for (auto& arg : fn.args) {
+                    if (!arg.interface.empty() && seen.emplace(arg.interface).second)
+                        ifaces.emplace_back(arg.interface);
+                }
+            }
+        }
+    }
+
+    return ifaces;
+}
+
+void HyprwaylandScanner::writeSourcePrologue(CWriter& out, const std::vector<std::string>& fileNames, const SOptions& options) {
+    // the std headers before private is defined away, which they don't all survive
+    out.format("#include <cstdint>\n#include <string>\n{}\n\n#define private public\n#define HYPRWAYLAND_SCANNER_NO_INTERFACES\n", handlerIncludes(options));
+    for (auto& fileName : fileNames) {
+        out.format("#include \"{}.hpp\"\n", fileName);
+    }
+    out.format("#undef private\n#define F {}\n", handlerType(options));
+}
+
+void HyprwaylandScanner::writeExterns(CWriter& out, const std::vector<std::string>& ifaces) {
+    out += R"#(
+// Reference all other interfaces.
+// The reason why this is in snake is to
+// be able to cooperate with existing
+// wayland_scanner interfaces (they are interop)
+)#";
+
+    for (auto& iface : ifaces) {
+        out.format("extern const wl_interface {}_interface;\n", iface);
+    }
+}
+
+// the type table of messages without args
+static std::string dummyTypeTableName(const SGenerationContext& ctx) {
+    return ctx.PROTO_DATA.name + "_dummyTypes";
+}
+
+static void writeDummyTypeTable(const SGenerationContext& ctx, CWriter& out) {
+    out.format(R"#(
+static const wl_interface* {}[] = {{ nullptr }};
+)#", dummyTypeTableName(ctx));
+}
+
+// reads the args of a recorded request and calls its handler, see Hyprwayland::CReplay
+static void writeReplay(SGenerationContext& ctx, const SInterface& iface) {
+    const auto CLASS_NAME = camelize(std::format("C_{}", iface.name));
+
+    std::string cases;
+    for (size_t i = 0; i < iface.requests.size(); ++i) {
+        const auto& RQ = iface.requests[i];
+
+        std::string reads, args;
+        for (auto& arg : RQ.args) {
+            const auto& TYPE = WPTypeToCType(ctx, arg, false);
+
+            std::string read;
+            if (arg.wlType == "object")
+                read = "reader.object()";
+            else if (arg.wlType == "string")
+                read = "reader.string()";
+            else if (arg.wlType == "array")
+                read = "reader.array()";
+            else if (arg.wlType == "fd")
+                read = "reader.fd()";
+            else if (arg.wlType == "int" || arg.wlType == "fixed")
+                read = TYPE == "int32_t" || TYPE == "wl_fixed_t" ? "reader.i32()" : std::format("({})reader.i32()", TYPE);
+            else
+                read = TYPE == "uint32_t" ? "reader.u32()" : std::format("({})reader.u32()", TYPE);
+
+            reads += std::format("            const auto {} = {};\n", arg.name, read);
+            args += std::format(", {}", arg.name);
+        }
+
+        cases += std::format("        case {}: {{\n{}            {}(reader.client, RESOURCE{});\n            return true;\n        }}\n", i, reads,
+                             camelize(std::format("_C_{}_{}", iface.name, RQ.name)), args);
+    }
+
+    ctx.SOURCE.format(R"#(
+static bool _{}Replay(Hyprwayland::CRecordReader& reader) {{)#",
+                      CLASS_NAME);
+
+    if (cases.empty())
+        ctx.SOURCE += "\n    return false;\n}\n";
+    else
+        ctx.SOURCE.format(R"#(
+    const auto RESOURCE = reader.target();
+    if (!RESOURCE)
+        return false;
+
+    switch (reader.header.opcode) {{
+{}        default: return false;
+    }}
+}}
+)#",
+                          cases);
+
+    ctx.SOURCE.format("\nstatic Hyprwayland::CReplay _{}ReplayRegistration{{{:#x}, \"{}\", &_{}Replay}};\n", CLASS_NAME, interfaceHash(iface.name), iface.name, CLASS_NAME);
+}
+
+void HyprwaylandScanner::parseSource(SGenerationContext& ctx) {
+    std::string DUMMY_TYPE_TABLE_NAME = dummyTypeTableName(ctx);
+
+    // amalgamations share the prologue and externs, see writeAmalgamation(),
+    // and modules have their own, see writeModule()
+    const bool  STANDALONE = !ctx.options.amalgamated && !ctx.options.module;
+
+    if (STANDALONE)
+        writeSourcePrologue(ctx.SOURCE, {ctx.PROTO_DATA.fileName}, ctx.options);
+
+    // reference interfaces
+
+    // dummy
+    writeDummyTypeTable(ctx, ctx.SOURCE);
+
+    if (STANDALONE)
+        writeExterns(ctx.SOURCE, referencedInterfaces(ctx));
+
+    // declare ifaces
+
+    for (auto& iface : ctx.XMLDATA.ifaces) {
+        // everything below only refers to this interface's statics, so it can go into a TU of its own
+        const size_t SPAN_START = ctx.SOURCE.view().size();
+
+        const auto IFACE_WL_NAME          = std::format("{}_interface", iface.name);
+        const auto IFACE_NAME             = iface.name;
+        const auto IFACE_NAME_CAMEL       = camelize(iface.name);
+        const auto IFACE_CLASS_NAME_CAMEL = camelize(std::format("{}{}", ctx.options.clientCode ? "CC_" : "C_", iface.name));
+
+        if (instrumented(ctx, iface)) {
+            ctx.SOURCE.format("\nconstinit Hyprwayland::SMessageStats {}::messageStats[{}] = {{\n", IFACE_CLASS_NAME_CAMEL, iface.requests.size() + iface.events.size());
+            for (auto& rq : iface.requests) {
+                ctx.SOURCE.format("    {{\"{}\", \"{}\", true}},\n", iface.name, rq.name);
+            }
+            for (auto& ev : iface.events) {
+                ctx.SOURCE.format("    {{\"{}\", \"{}\", false}},\n", iface.name, ev.name);
+            }
+            ctx.SOURCE.format("}};\n\nstatic Hyprwayland::CMessageStatsRegistration _{}StatsRegistration{{{}::messageStats}};\n", IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
+        }
+
+        // create handlers
+        // in a module they can't be static, the classes befriend them
+        const auto HANDLER_LINKAGE = ctx.options.module ? "" : "static ";
+
+        const auto& HANDLED = ctx.options.clientCode ? iface.events : iface.requests;
+        for (size_t i = 0; i < HANDLED.size(); ++i) {
+            const auto& rq    = HANDLED[i];
+            std::string argsN = ", ";
+            for (auto& arg : rq.args) {
+                argsN += std::format("{}, ", arg.name);
+            }
+
+            if (!argsN.empty()) {
+                argsN.pop_back();
+                argsN.pop_back();
+            }
+
+            if (!ctx.options.clientCode) {
+                ctx.SOURCE.format(R"#(
+{}{} {{
+{}    const auto PO = ({}*)wl_resource_get_user_data(resource);
+    if (PO && PO->requests.{})
+        PO->requests.{}(PO{});
+}}
+)#",
+                                  HANDLER_LINKAGE, handlerSignature(ctx, iface, rq),
+                                  timerLine(ctx, iface, IFACE_CLASS_NAME_CAMEL, i, "    ") +
+                                      recordLine(ctx, iface, "wl_resource_get_id(resource)", i, true, recordArgs(ctx, rq, false, false), "    "),
+                                  IFACE_CLASS_NAME_CAMEL, camelize(rq.name), camelize(rq.name), argsN);
+            } else {
+                ctx.SOURCE.format(R"#(
+{}{} {{
+{}    const auto PO = ({}*)data;
+    if (PO && PO->requests.{})
+        PO->requests.{}(PO{});
+}}
+)#",
+                                  HANDLER_LINKAGE, handlerSignature(ctx, iface, rq),
+                                  timerLine(ctx, iface, IFACE_CLASS_NAME_CAMEL, i, "    ") +
+                                      recordLine(ctx, iface, "wl_proxy_get_id((wl_proxy*)resource)", i, false, recordArgs(ctx, rq, false, false), "    "),
+                                  IFACE_CLASS_NAME_CAMEL, camelize(rq.name), camelize(rq.name), argsN);
+            }
+        }
+
+        // destroy handler
+        if (!ctx.options.clientCode) {
+            ctx.SOURCE.format(R"#(
+{}{} {{
+    {}DestroyWrapper *wrap = wl_container_of(l, wrap, listener);
+    {}* pResource = wrap->parent;
+    pResource->onDestroyCalled();
+}}
+)#",
+                              HANDLER_LINKAGE, destroyListenerSignature(IFACE_CLASS_NAME_CAMEL), IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
+        }
+
+        // replaying recorded requests through the handlers above. Static dispatch doesn't use them
+        if (ctx.options.record && !ctx.options.clientCode && !ctx.options.staticDispatch)
+            writeReplay(ctx, iface);
+
+        // create vtable
+
+        const auto IFACE_VTABLE_NAME = "_" + IFACE_CLASS_NAME_CAMEL + "VTable";
+
+        ctx.SOURCE.format(R"#(
+static const void* {}[] = {{
+)#",
+                          IFACE_VTABLE_NAME);
+
+        for (auto& rq : (ctx.options.clientCode ? iface.events : iface.requests)) {
+            const auto REQUEST_NAME = camelize(std::format("_C_{}_{}", IFACE_NAME, rq.name));
+            ctx.SOURCE.format("    (void*){},\n", REQUEST_NAME);
+        }
+
+        if ((ctx.options.clientCode ? iface.events : iface.requests).empty()) {
+            ctx.SOURCE += "    nullptr,\n";
+        }
+
+        ctx.SOURCE += "};\n";
+
+        // create events
+
+        const bool  COALESCED = hasCoalesced(ctx, iface);
+        const auto  SELF_ID   = ctx.options.clientCode ? "wl_proxy_get_id(pResource)" : "wl_resource_get_id(pResource)";
+        std::string flushes;
+        // the objects with coalesced events pending, for flushAllCoalesced(). One for the whole process,
+        // not guarded, so like the objects themselves only for the thread dispatching them
+        if (COALESCED)
+            ctx.SOURCE.format("\nstatic std::vector<{}*> _{}Coalesced;\n", IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
+
+        int evid = 0;
+        for (auto& ev : (!ctx.options.clientCode ? iface.events : iface.requests)) {
+            const auto  EVENT_NAME = camelize(std::format("send_{}", ev.name));
+
+            std::string argsC = "";
+            for (auto& arg : ev.args) {
+                if (arg.newType)
+                    continue;
+                argsC += std::format("{} {}, ", WPTypeToCType(ctx, arg, true), arg.name);
+            }
+
+            if (!argsC.empty()) {
+                argsC.pop_back();
+                argsC.pop_back();
+            }
+
+            std::vector<std::string> values;
+            for (auto& arg : ev.args) {
+                if (arg.newType)
+                    values.emplace_back("nullptr");
+                else if (!WPTypeToCType(ctx, arg, true).starts_with("C"))
+                    values.emplace_back(arg.name);
+                else
+                    values.emplace_back(std::format("{} ? {}->pResource : nullptr", arg.name, arg.name));
+            }
+
+            // coalesced ones only keep their args until flushCoalesced(), the others flush them first
+            if (coalesces(ctx, iface, ev)) {
+                const auto PENDING = std::format("coalesced.{}", camelize(ev.name));
+
+                std::string argsP = "";
+                for (auto& value : values) {
+                    argsP += std::format(", {}", value);
+                }
+
+                std::vector<std::string> pendingValues;
+                for (auto& arg : ev.args) {
+                    pendingValues.emplace_back(std::format("{}.{}", PENDING, arg.name));
+                }
+
+                const auto [ARRAY, CALL] = sendCall(ctx, ev, evid, pendingValues);
+
+                ctx.SOURCE.format(R"#(
+void {}::{}({}) {{
+    if (!pResource)
+        return;
+
+    {} = {{true{}}};
+
+    if (!coalescedQueued) {{
+        coalescedQueued = true;
+        _{}Coalesced.emplace_back(this);
+    }}
+}}
+)#",
+                                  IFACE_CLASS_NAME_CAMEL, EVENT_NAME, argsC, PENDING, argsP, IFACE_CLASS_NAME_CAMEL);
+
+                // the array is one line
+                flushes += std::format("\n    if ({}.pending) {{\n        {}.pending = false;\n{}{}{}{}        {};\n    }}\n", PENDING, PENDING, countLine(ctx, iface, evid, "        "),
+                                       recordLine(ctx, iface, SELF_ID, evid, ctx.options.clientCode, recordArgs(ctx, ev, true, false, PENDING + "."), "        "),
+                                       (ARRAY.empty() ? "" : "    "), ARRAY, CALL);
+
+                evid++;
+                continue;
+            }
+
+            const auto [ARRAY, CALL] = sendCall(ctx, ev, evid, values);
+
+            if (!ctx.options.clientCode) {
+                const auto SEND = std::format("{}{}{}{}    {};", (COALESCED ? "    flushCoalesced();\n" : ""), countLine(ctx, iface, evid, "    "),
+                                              recordLine(ctx, iface, SELF_ID, evid, false, recordArgs(ctx, ev, true, false), "    "), ARRAY, CALL);
+
+                ctx.SOURCE.format(R"#(
+void {}::{}({}) {{
+    if (!pResource)
+        return;
+{}
+}}
+)#",
+                                  IFACE_CLASS_NAME_CAMEL, EVENT_NAME, argsC, SEND);
+            } else {
+                std::string retType    = ev.newIdType.empty() ? "void" : "wl_proxy";
+                std::string ptrRetType = ev.newIdType.empty() ? "void" : "wl_proxy*";
+                const auto  SEND       = std::format("{}{}{}    auto proxy = {};", countLine(ctx, iface, evid, "    "),
+                                                     recordLine(ctx, iface, SELF_ID, evid, true, recordArgs(ctx, ev, true, false), "    "), ARRAY, CALL);
+
+                ctx.SOURCE.format(R"#(
+{} {}::{}({}) {{
+    if (!pResource)
+        return{};{}
+
+{}{}
+}}
+)#",
+                                  ptrRetType, IFACE_CLASS_NAME_CAMEL, EVENT_NAME, argsC, (ev.newIdType.empty() ? "" : " nullptr"),
+                                  std::format("{}{}", (COALESCED ? "\n    flushCoalesced();" : ""), (ev.destructor ? "\n    destroyed = true;" : "")), SEND,
+                                  (ev.newIdType.empty() ? "\n    proxy;" : "\n\n    return proxy;"));
+
+                if (createsOnQueue(ctx, ev)) {
+                    const auto [QARRAY, QCALL] = sendCall(ctx, ev, evid, values, "wrapper");
+
+                    // the wrapper makes the new proxy on queue right away, so none of its events can go to another
+                    ctx.SOURCE.format(R"#(
+wl_proxy* {}::{}({}{}wl_event_queue* queue) {{
+    if (!pResource)
+        return nullptr;{}
+
+    auto wrapper = (wl_proxy*)wl_proxy_create_wrapper(pResource);
+    if (!wrapper)
+        return nullptr;
+
+    wl_proxy_set_queue(wrapper, queue);
+
+{}{}{}    auto proxy = {};
+    wl_proxy_wrapper_destroy(wrapper);
+
+    return proxy;
+}}
+)#",
+                                      IFACE_CLASS_NAME_CAMEL, EVENT_NAME, argsC, (argsC.empty() ? "" : ", "), (COALESCED ? "\n    flushCoalesced();" : ""),
+                                      countLine(ctx, iface, evid, "    "), recordLine(ctx, iface, SELF_ID, evid, true, recordArgs(ctx, ev, true, false), "    "), QARRAY, QCALL);
+                }
+            }
+
+            evid++;
+        }
+
+        if (COALESCED) {
+            ctx.SOURCE.format(R"#(
+void {}::flushCoalesced() {{
+    if (!pResource{})
+        return;
+{}}}
+
+void {}::flushAllCoalesced() {{
+    for (auto& object : _{}Coalesced) {{
+        object->coalescedQueued = false;
+        object->flushCoalesced();
+    }}
+
+    _{}Coalesced.clear();
+}}
+)#",
+                              IFACE_CLASS_NAME_CAMEL, (ctx.options.clientCode ? " || destroyed" : ""), flushes, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
+        }
+
+        // dangerous
+        if (!ctx.options.clientCode) {
+            evid = 0;
+            for (auto& ev : iface.events) {
+                const auto  EVENT_NAME = camelize(std::format("send_{}_raw", ev.name));
+
+                std::string argsC = "";
+                for (auto& arg : ev.args) {
+                    if (arg.newType)
+                        continue;
+                    argsC += std::format("{} {}, ", WPTypeToCType(ctx, arg, true, true), arg.name);
+                }
+
+                if (!argsC.empty()) {
+                    argsC.pop_back();
+                    argsC.pop_back();
+                }
+
+                // the array needs every slot, varargs none for the new_ids
+                std::vector<std::string> values;
+                for (auto& arg : ev.args) {
+                    if (arg.newType && !marshalsAsArray(ctx, ev))
+                        continue;
+                    values.emplace_back(arg.newType ? "nullptr" : arg.name);
+                }
+
+                const auto [ARRAY, CALL] = sendCall(ctx, ev, evid, values);
+                const auto SEND          = std::format("{}{}{}{}    {};", (COALESCED ? "    flushCoalesced();\n" : ""), countLine(ctx, iface, evid, "    "),
+                                                       recordLine(ctx, iface, SELF_ID, evid, false, recordArgs(ctx, ev, true, true), "    "), ARRAY, CALL);
+
+                ctx.SOURCE.format(R"#(
+void {}::{}({}) {{
+    if (!pResource)
+        return;
+{}
+}}
+)#",
+                                  IFACE_CLASS_NAME_CAMEL, EVENT_NAME, argsC, SEND);
+
+                evid++;
+            }
+        }
+
+        // wayland interfaces and stuff
+
+        // type tables
+        for (auto& rq : iface.requests) {
+            if (rq.args.empty())
+                continue;
+
+            const auto TYPE_TABLE_NAME = camelize(std::format("_C_{}_{}_types", IFACE_NAME, rq.name));
+            ctx.SOURCE.format("static const wl_interface* {}[] = {{\n", TYPE_TABLE_NAME);
+
+            for (auto& arg : rq.args) {
+                if (arg.interface.empty()) {
+                    ctx.SOURCE += "    nullptr,\n";
+                    continue;
+                }
+
+                ctx.SOURCE.format("    &{}_interface,\n", arg.interface);
+            }
+
+            ctx.SOURCE += "};\n";
+        }
+        for (auto& ev : iface.events) {
+            if (ev.args.empty())
+                continue;
+
+            const auto TYPE_TABLE_NAME = camelize(std::format("_C_{}_{}_types", IFACE_NAME, ev.name));
+            ctx.SOURCE.format("static const wl_interface* {}[] = {{\n", TYPE_TABLE_NAME);
+
+            for (auto& arg : ev.args) {
+                if (arg.interface.empty()) {
+                    ctx.SOURCE += "    nullptr,\n";
+                    continue;
+                }
+
+                ctx.SOURCE.format("    &{}_interface,\n", arg.interface);
+            }
+
+            ctx.SOURCE += "};\n";
+        }
+
+        const auto MESSAGE_NAME_REQUESTS = camelize(std::format("_C_{}_requests", IFACE_NAME));
+        const auto MESSAGE_NAME_EVENTS   = camelize(std::format("_C_{}_events", IFACE_NAME));
+
+        // message
+        if (!ctx.options.noInterfaces) {
+            if (iface.requests.size() > 0) {
+                ctx.SOURCE.format(R"#(
+static const wl_message {}[] = {{
+)#",
+                                  MESSAGE_NAME_REQUESTS);
+                for (auto& rq : iface.requests) {
+                    // create type table
+                    const auto TYPE_TABLE_NAME = camelize(std::format("_C_{}_{}_types", IFACE_NAME, rq.name));
+
+                    ctx.SOURCE.format("    {{ .name = \"{}\", .signature = \"{}\", .types = {}}},\n", rq.name, rq.signature,
+                                      rq.args.empty() ?  std::format("{} + 0", DUMMY_TYPE_TABLE_NAME) : TYPE_TABLE_NAME + " + 0");
+                }
+
+                ctx.SOURCE += "};\n";
+            }
+
+            if (iface.events.size() > 0) {
+                ctx.SOURCE.format(R"#(
+static const wl_message {}[] = {{
+)#",
+                                  MESSAGE_NAME_EVENTS);
+                for (auto& ev : iface.events) {
+                    // create type table
+                    const auto TYPE_TABLE_NAME = camelize(std::format("_C_{}_{}_types", IFACE_NAME, ev.name));
+
+                    ctx.SOURCE.format("    {{ .name = \"{}\", .signature = \"{}\", .types = {}}},\n", ev.name, ev.signature,
+                                      ev.args.empty() ? std::format("{} + 0", DUMMY_TYPE_TABLE_NAME) : TYPE_TABLE_NAME + " + 0");
+                }
+
+                ctx.SOURCE += "};\n";
+            }
+
+            // iface
+            // in a module, it has to stay attached to the global module to interop with everyone else
+            ctx.SOURCE.format(R"#(
+{}const wl_interface {} = {{
+    .name = "{}", .version = {},
+    .method_count = {}, .methods = {},
+    .event_count = {}, .events = {},
+}};
+)#",
+                              (ctx.options.module ? "extern \"C++\" " : ""), IFACE_WL_NAME, iface.name, iface.version, iface.requests.size(),
+                              (iface.requests.size() > 0 ? MESSAGE_NAME_REQUESTS : "nullptr"),
+                              iface.events.size(), (iface.events.size() > 0 ? MESSAGE_NAME_EVENTS : "nullptr"));
+        }
+
+        if (ctx.options.pool) {
+            ctx.SOURCE.format(R"#(
+static constinit Hyprwayland::CPool _{}Pool{{sizeof({}), alignof({})}};
+
+void* {}::operator new(size_t size) {{
+    if (size != sizeof({}))
+        return ::operator new(size);
+    return _{}Pool.allocate();
+}}
+
+void {}::operator delete(void* p, size_t size) {{
+    if (size != sizeof({})) {{
+        ::operator delete(p, size);
+        return;
+    }}
+    _{}Pool.deallocate(p);
+}}
+
+const Hyprwayland::SPoolStats& {}::poolStats() {{
+    return _{}Pool.statistics();
+}}
+
+void {}::reservePool(size_t count) {{
+    _{}Pool.reserve(count);
+}}
+)#",
+                              IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL,
+                              IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL,
+                              IFACE_CLASS_NAME_CAMEL);
+        }
+
+        const bool REGISTRY = ctx.options.broadcast && !ctx.options.clientCode;
+        if (REGISTRY) {
+            ctx.SOURCE.format(R"#(
+static constinit Hyprwayland::CInstanceRegistry<{}> _{}Instances;
+
+const Hyprwayland::CInstanceRegistry<{}>& {}::instances() {{
+    return _{}Instances;
+}}
+)#",
+                              IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
+
+            // the args are marshalled once for all of them
+            for (size_t evid = 0; evid < iface.events.size(); ++evid) {
+                const auto& EV = iface.events[evid];
+                if (!hasBroadcast(ctx, EV))
+                    continue;
+
+                std::string              args = "";
+                std::vector<std::string> values;
+                for (auto& arg : EV.args) {
+                    args += std::format("{} {}, ", WPTypeToCType(ctx, arg, true), arg.name);
+                    values.emplace_back(arg.name);
+                }
+
+                if (!args.empty()) {
+                    args.pop_back();
+                    args.pop_back();
+                }
+
+                const auto SINCE   = EV.since.empty() ? 1 : std::stoi(std::string{EV.since});
+                const auto VERSION = SINCE > 1 ? std::format("\n        if (instance.version < {})\n            continue;", SINCE) : "";
+                const auto NAME    = camelize(std::format("broadcast_{}", EV.name));
+
+                for (const bool CLIENT : {false, true}) {
+                    ctx.SOURCE.format(R"#(
+void {}::{}({}{}{}) {{
+{}    for (auto& instance : _{}Instances.{}) {{{}
+{}{}{}        wl_resource_post_event_array(instance.resource, {}, {});
+    }}
+}}
+)#",
+                                      IFACE_CLASS_NAME_CAMEL, NAME, (CLIENT ? "wl_client* client" : ""), (CLIENT && !args.empty() ? ", " : ""), args, wlArgumentArray(EV, values),
+                                      IFACE_CLASS_NAME_CAMEL, (CLIENT ? "client(client)" : "all()"), VERSION, (COALESCED ? "        instance.object->flushCoalesced();\n" : ""),
+                                      countLine(ctx, iface, evid, "        "),
+                                      recordLine(ctx, iface, "wl_resource_get_id(instance.resource)", evid, false, recordArgs(ctx, EV, true, false), "        "), evid,
+                                      (EV.args.empty() ? "nullptr" : "args"));
+                }
+            }
+        }
+
+        // protocol body
+        // with static dispatch, the implementation comes from the CRTP template, see writeStaticDispatch()
+        const auto IMPLEMENTATION_PARAM = ctx.options.staticDispatch ? ", Hyprwayland::SStaticImplementation implementation" : "";
+        const auto IMPLEMENTATION       = ctx.options.staticDispatch ? std::string{"implementation.table"} : (ctx.options.clientCode ? "&" : "") + IFACE_VTABLE_NAME;
+
+        // so a replay knows which objects the requests didn't create
+        const auto CREATED = ctx.options.record ?
+            std::format("\n\n    if (Hyprwayland::CRecorder::active)\n        Hyprwayland::CRecorder::record({:#x}, id, Hyprwayland::CRecorder::CREATED, true, version);",
+                        interfaceHash(iface.name)) :
+            "";
+
+        // a deleted object can't stay queued for flushAllCoalesced()
+        const auto DEQUEUE = COALESCED ? std::format("\n\n    if (coalescedQueued)\n        std::erase(_{}Coalesced, this);", IFACE_CLASS_NAME_CAMEL) : "";
+
+        if (!ctx.options.clientCode) {
+            if (ctx.options.staticDispatch)
+                ctx.SOURCE.format("\n{}::{}(wl_client* client, uint32_t version, uint32_t id) : {}(client, version, id, {{{}}}) {{}}\n", IFACE_CLASS_NAME_CAMEL,
+                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_VTABLE_NAME);
+
+            ctx.SOURCE.format(R"#(
+{}::{}(wl_client* client, uint32_t version, uint32_t id{}) :
+    pResource(wl_resource_create(client, &{}, version, id)) {{
+
+    if (!pResource)
+        return;
+
+    wl_resource_set_user_data(pResource, this);
+    wl_list_init(&resourceDestroyListener.listener.link);
+    resourceDestroyListener.listener.notify = _{}__DestroyListener;
+    resourceDestroyListener.parent = this;
+    wl_resource_add_destroy_listener(pResource, &resourceDestroyListener.listener);
+
+    wl_resource_set_implementation(pResource, {}, this, nullptr);{}
+}}
+
+{}::~{}() {{
+    wl_list_remove(&resourceDestroyListener.listener.link);
+    wl_list_init(&resourceDestroyListener.listener.link);{}
+
+    // if we still own the wayland resource,
+    // it means we need to destroy it.
+    if (pResource && wl_resource_get_user_data(pResource) == this) {{
+        wl_resource_set_user_data(pResource, nullptr);
+        wl_resource_destroy(pResource);
+    }}
+}}
+
+void {}::onDestroyCalled() {{{}
+    wl_resource_set_user_data(pResource, nullptr);
+    wl_list_remove(&resourceDestroyListener.listener.link);
+    wl_list_init(&resourceDestroyListener.listener.link);
+
+    // set the resource to nullptr,
+    // as it will be freed. If the consumer does not destroy this resource
+    // in onDestroy here, we'd be doing a UAF in the ~dtor
+    pResource = nullptr;
+
+    if (onDestroy)
+        onDestroy(this);
+}}
+)#",
+                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IMPLEMENTATION_PARAM, IFACE_WL_NAME, IFACE_CLASS_NAME_CAMEL,
+                                  IMPLEMENTATION,
+                                  (REGISTRY ? std::format("\n\n    _{}Instances.add(this, client, pResource);", IFACE_CLASS_NAME_CAMEL) : "") + CREATED,
+                                  IFACE_CLASS_NAME_CAMEL,
+                                  IFACE_CLASS_NAME_CAMEL, (REGISTRY ? std::format("\n\n    if (pResource)\n        _{}Instances.remove(this, pResource);", IFACE_CLASS_NAME_CAMEL) : "") + DEQUEUE,
+                                  IFACE_CLASS_NAME_CAMEL, (REGISTRY ? std::format("\n    _{}Instances.remove(this, pResource);", IFACE_CLASS_NAME_CAMEL) : ""));
+        } else {
+            std::string DTOR_FUNC = "";
+
+            for (auto& rq : iface.requests) {
+                if (!rq.destructor)
+                    continue;
+
+                DTOR_FUNC = camelize(std::format("send_{}", rq.name)) + "()";
+                break;
+            }
+
+            if (DTOR_FUNC.empty())
+                DTOR_FUNC = "wl_proxy_destroy(pResource)";
+
+            if (ctx.options.staticDispatch) {
+                ctx.SOURCE.format("\n{}::{}(wl_proxy* resource) : {}(resource, {{&{}}}) {{}}\n", IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL,
+                                  IFACE_VTABLE_NAME);
+                if (eventQueues(ctx))
+                    ctx.SOURCE.format("\n{}::{}(wl_proxy* resource, wl_event_queue* queue) : {}(resource, queue, {{&{}}}) {{}}\n", IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL,
+                                      IFACE_CLASS_NAME_CAMEL, IFACE_VTABLE_NAME);
+            }
+
+            if (!eventQueues(ctx))
+                ctx.SOURCE.format(R"#(
+{}::{}(wl_proxy* resource{}) : pResource(resource) {{
+
+    if (!pResource)
+        return;
+
+    wl_proxy_add_listener(pResource, (void (**)(void)){}, this);
+}}
+)#",
+                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IMPLEMENTATION_PARAM, IMPLEMENTATION);
+            else
+                // the queue goes first, so none of the events can be dispatched on the old one
+                ctx.SOURCE.format(R"#(
+{}::{}(wl_proxy* resource{}) : pResource(resource) {{
+    addListener({});
+}}
+
+{}::{}(wl_proxy* resource, wl_event_queue* queue{}) : pResource(resource) {{
+    setQueue(queue);
+    addListener({});
+}}
+
+void {}::addListener(const void* implementation) {{
+    if (!pResource)
+        return;
+
+    wl_proxy_add_listener(pResource, (void (**)(void))implementation, this);
+}}
+)#",
+                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IMPLEMENTATION_PARAM, IMPLEMENTATION, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL,
+                                  IMPLEMENTATION_PARAM, IMPLEMENTATION, IFACE_CLASS_NAME_CAMEL);
+
+            ctx.SOURCE.format(R"#(
+{}::~{}() {{
+    if (!destroyed)
+        {};{}
+}}
+)#",
+                              IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, DTOR_FUNC, DEQUEUE);
+        }
+
+        for (auto& rq : (ctx.options.clientCode ? iface.events : iface.requests)) {
+            std::string args = ", ";
+            for (auto& arg : rq.args) {
+                args += WPTypeToCType(ctx, arg, false) + ", ";
+            }
+
+            args.pop_back();
+            args.pop_back();
+
+            ctx.SOURCE.format(R"#(
+void {}::{}(F<void({}*{})> &&handler) {{
+    requests.{} = std::move(handler);
+}}
+)#",
+                                  IFACE_CLASS_NAME_CAMEL, camelize(std::format("set_{}", rq.name)), IFACE_CLASS_NAME_CAMEL, args, camelize(rq.name));
+        }
+
+        ctx.sourceSpans.emplace_back(SPAN_START, ctx.SOURCE.view().size());
+    }
+
+    if (STANDALONE)
+        ctx.SOURCE += "\n#undef F\n";
+}
+
+// The source split into TUs that compile in parallel: one per interface, or a few of similar
+// size. Each gets the prologue, dummy table and externs of the whole source.
+void HyprwaylandScanner::writeSourceShards(SGenerationContext& ctx) {
+    const auto& IFACES = ctx.XMLDATA.ifaces;
+    const auto  SOURCE = ctx.SOURCE.view();
+
+    // interface indices of each shard, and its name
+    std::vector<std::pair<std::string, std::vector<size_t>>> shards;
+    if (ctx.options.sourceShards == 0) {
+        for (size_t i = 0; i < IFACES.size(); ++i) {
+            shards.push_back({std::format("{}-{}.cpp", ctx.PROTO_DATA.fileName, IFACES[i].name), {i}});
+        }
+    } else {
+        for (size_t i = 0; i < ctx.options.sourceShards; ++i) {
+            shards.push_back({std::format("{}-{}.cpp", ctx.PROTO_DATA.fileName, i), {}});
+        }
+
+        // biggest first onto the smallest shard, then back to input order within each shard
+        std::vector<size_t> order(IFACES.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+
+        const auto SPAN_SIZE = [&](size_t idx) { return ctx.sourceSpans[idx].second - ctx.sourceSpans[idx].first; };
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return SPAN_SIZE(a) > SPAN_SIZE(b); });
+
+        std::vector<size_t> shardSizes(shards.size(), 0);
+        for (const auto IDX : order) {
+            const auto SMALLEST = std::min_element(shardSizes.begin(), shardSizes.end()) - shardSizes.begin();
+            shards[SMALLEST].second.emplace_back(IDX);
+            shardSizes[SMALLEST] += SPAN_SIZE(IDX);
+        }
+
+        for (auto& [name, indices] : shards) {
+            std::sort(indices.begin(), indices.end());
+        }
+    }
+
+    const auto EXTERNS = referencedInterfaces(ctx);
+
+    // only messages without args use the dummy table, and unused statics warn
+    const auto USES_DUMMY = [&](size_t idx) {
+        if (ctx.options.noInterfaces)
+            return false;
+        const auto HAS_NO_ARGS = [](const SWaylandFunction& fn) { return fn.args.empty(); };
+        return std::any_of(IFACES[idx].requests.begin(), IFACES[idx].requests.end(), HAS_NO_ARGS) ||
+            std::any_of(IFACES[idx].events.begin(), IFACES[idx].events.end(), HAS_NO_ARGS);
+    };
+
+    for (auto& [name, indices] : shards) {
+        CWriter source;
+        source += ctx.copyright;
+        writeSourcePrologue(source, {ctx.PROTO_DATA.fileName}, ctx.options);
+        if (std::any_of(indices.begin(), indices.end(), USES_DUMMY))
+            writeDummyTypeTable(ctx, source);
+        writeExterns(source, EXTERNS);
+
+        for (const auto IDX : indices) {
+            const auto& [START, END] = ctx.sourceSpans[IDX];
+            source += SOURCE.substr(START, END - START);
+        }
+
+        source += "\n#undef F\n";
+
+        ctx.SOURCE_SHARDS.emplace_back(std::move(name), std::move(source));
+    }
+}
+
+// a protocol name as one C++ identifier
+static std::string identifier(std::string_view name) {
+    std::string sanitized{name};
+    for (auto& c : sanitized) {
+        if (!std::isalnum((unsigned char)c))
+            c = '_';
+    }
+    return sanitized;
+}
+
+namespace {
+    // how the harnesses get the object of an interface: a global, or the factory request of its parent
+    struct SBenchObject {
+        const SInterface*       iface   = nullptr;
+        const SInterface*       parent  = nullptr;
+        const SWaylandFunction* factory = nullptr;
+    };
+}
+
+static bool hasBenchObject(const std::vector<SBenchObject>& objects, std::string_view name) {
+    return std::any_of(objects.begin(), objects.end(), [name](const auto& object) { return object.iface->name == name; });
+}
+
+// --bench-harness and --loadgen: the interfaces the harnesses have objects of, parents first. Ones no new_id
+// creates are globals, the others come from a request creating them on one there is an object of already,
+// if the harness has all its other args. Interfaces only events create are left out.
+static std::vector<SBenchObject> benchObjects(const SGenerationContext& ctx) {
+    const auto& IFACES  = ctx.XMLDATA.ifaces;
+    const auto  CREATED = [&](const SInterface& iface) {
+        return std::any_of(IFACES.begin(), IFACES.end(), [&](const auto& other) {
+            const auto CREATES = [&](const SWaylandFunction& fn) {
+                return std::any_of(fn.args.begin(), fn.args.end(), [&](const auto& arg) { return arg.wlType == "new_id" && arg.interface == iface.name; });
+            };
+            return std::any_of(other.requests.begin(), other.requests.end(), CREATES) || std::any_of(other.events.begin(), other.events.end(), CREATES);
+        });
+    };
+
+    std::vector<SBenchObject> objects;
+    for (auto& iface : IFACES) {
+        if (!CREATED(iface))
+            objects.emplace_back(SBenchObject{.iface = &iface});
+    }
+
+    // each pass can make the children of the previous one's
+    for (bool added = true; added;) {
+        added = false;
+        for (auto& iface : IFACES) {
+            if (hasBenchObject(objects, iface.name))
+                continue;
+
+            for (size_t i = 0; i < objects.size() && !hasBenchObject(objects, iface.name); ++i) {
+                for (auto& rq : objects[i].iface->requests) {
+                    const bool FACTORY = !rq.destructor &&
+                        std::any_of(rq.args.begin(), rq.args.end(), [&](const auto& arg) { return arg.wlType == "new_id" && arg.interface == iface.name; });
+                    const bool MISSING_ARGS = std::any_of(rq.args.begin(), rq.args.end(), [&](const auto& arg) {
+                        return (arg.wlType == "new_id" && arg.interface != iface.name) || arg.wlType == "fd" ||
+                            (arg.wlType == "object" && !arg.allowNull && !hasBenchObject(objects, arg.interface));
+                    });
+                    if (!FACTORY || MISSING_ARGS)
+                        continue;
+
+                    objects.emplace_back(SBenchObject{.iface = &iface, .parent = objects[i].iface, .factory = &rq});
+                    added = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    return objects;
+}
+
+// messages the harnesses can send with nothing but one object of each interface they have,
+// so no destructors, new_ids or fds, and other objects only where they can be null
+static bool benchable(const std::vector<SBenchObject>& objects, const SWaylandFunction& fn) {
+    return !fn.destructor && std::none_of(fn.args.begin(), fn.args.end(), [&](const auto& arg) {
+        return arg.wlType == "new_id" || arg.wlType == "fd" || (arg.wlType == "object" && !arg.allowNull && !hasBenchObject(objects, arg.interface));
+    });
+}
+
+// the benchable requests or events of all interfaces, in the order both sides refer to them by
+static std::vector<std::pair<const SInterface*, const SWaylandFunction*>> benchMessages(const SGenerationContext& ctx, bool requests) {
+    const auto                                                         OBJECTS = benchObjects(ctx);
+    std::vector<std::pair<const SInterface*, const SWaylandFunction*>> messages;
+    for (auto& iface : ctx.XMLDATA.ifaces) {
+        if (!hasBenchObject(OBJECTS, iface.name))
+            continue;
+
+        for (auto& fn : (requests ? iface.requests : iface.events)) {
+            if (benchable(OBJECTS, fn))
+                messages.emplace_back(&iface, &fn);
+        }
+    }
+    return messages;
+}
+
+// the server handler of a factory request, making the object with the new_id
+static std::string factoryHandler(const SBenchObject& object, std::string_view make) {
+    std::string params;
+    for (auto& arg : object.factory->args) {
+        params += arg.wlType == "new_id" ? ", uint32_t id" : ", auto";
+    }
+
+    return std::format("{}([]({}* self{}) {{ {}(self->client(), self->version(), id); }});", camelize(std::format("set_{}", object.factory->name)),
+                       camelize(std::format("C_{}", object.parent->name)), params, make);
+}
+
+// "interface.message", ... for a table of them
+static std::string benchNames(const std::vector<std::pair<const SInterface*, const SWaylandFunction*>>& messages) {
+    std::string names;
+    for (auto& [iface, fn] : messages) {
+        names += std::format("{}\"{}.{}\"", names.empty() ? "" : ", ", iface->name, fn->name);
+    }
+    return names;
+}
+
+// placeholder args: zeroes, null where allowed, and where not the object of that interface the
+// harness has, prefix + interface + suffix
+static std::string benchArgs(const SWaylandFunction& fn, std::string_view prefix, std::string_view suffix) {
+    std::string args;
+    for (auto& arg : fn.args) {
+        // the client gets those back
+        if (arg.wlType == "new_id")
+            continue;
+
+        if (!args.empty())
+            args += ", ";
+
+        if (arg.wlType == "string")
+            args += "\"hyprwayland-scanner\"";
+        else if (arg.wlType == "array")
+            args += "&emptyArray";
+        else if (arg.wlType == "object" && !arg.allowNull)
+            args += std::format("{}{}{}", prefix, camelize(arg.interface), suffix);
+        else
+            args += "{}";
+    }
+    return args;
+}
+
+// One side of a benchmark sending every message it can between a client and a server in one process.
+// The two headers can't go into one TU, so the client half has main() and the timing, and drives
+// the server half through a few functions.
+void HyprwaylandScanner::writeBenchHarness(SGenerationContext& ctx) {
+    const bool  CLIENT     = ctx.options.clientCode;
+    const auto& FILE_NAME  = ctx.PROTO_DATA.fileName;
+    const auto  CLASS      = CLIENT ? "CC_" : "C_";
+    const auto  NAME_SPACE = identifier(ctx.PROTO_DATA.nameOriginal);
+
+    // it counts through the setX() handlers, which the static dispatch templates never call
+    if (ctx.options.staticDispatch)
+        throw std::runtime_error("the bench harness can't be generated with static dispatch");
+
+    const auto  requests   = benchMessages(ctx, true);
+    const auto  events     = benchMessages(ctx, false);
+
+    const auto& SENT     = CLIENT ? requests : events;
+    const auto& HANDLED  = CLIENT ? events : requests;
+    const auto  COUNTER  = CLIENT ? "events" : "requests";
+    const bool  USES_ARR = std::any_of(SENT.begin(), SENT.end(), [](const auto& msg) {
+        return std::any_of(msg.second->args.begin(), msg.second->args.end(), [](const auto& arg) { return arg.wlType == "array"; });
+    });
+
+    const auto   OBJECTS = benchObjects(ctx);
+    const size_t GLOBALS = std::count_if(OBJECTS.begin(), OBJECTS.end(), [](const auto& object) { return !object.parent; });
+
+    // the globals are bound, and the other objects made through their factory requests
+    std::string members, binds, makes, deletes;
+    CWriter     cases;
+    for (auto& object : OBJECTS) {
+        const auto& iface      = *object.iface;
+        const auto  CLASS_NAME = camelize(std::format("{}{}", CLASS, iface.name));
+        const auto  OBJECT     = "objects." + camelize(iface.name);
+        const auto  MAKE       = camelize(std::format("make_{}", iface.name));
+        const auto  INDENT     = CLIENT && !object.parent ? "            " : "        ";
+
+        members += std::format("        {}* {} = nullptr;\n", CLASS_NAME, camelize(iface.name));
+        // children first, parents may not outlive them
+        deletes = std::format("        delete {};\n", OBJECT) + deletes;
+
+        std::string handlers;
+        for (auto& [handledIface, fn] : HANDLED) {
+            if (handledIface == &iface)
+                handlers += std::format("{}{}->{}([](auto...) {{ ++{}; }});\n", INDENT, OBJECT, camelize(std::format("set_{}", fn->name)), COUNTER);
+        }
+
+        if (CLIENT && !object.parent)
+            binds += std::format(R"#(        if (std::strcmp(interface, "{}") == 0) {{
+            {} = new {}((wl_proxy*)wl_registry_bind(registry, name, &{}_interface, std::min<uint32_t>(version, {})));
+{}        }}
+)#",
+                                 iface.name, OBJECT, CLASS_NAME, iface.name, iface.version, handlers);
+        else if (CLIENT)
+            makes += std::format("        {} = new {}(objects.{}->{}({}));\n{}", OBJECT, CLASS_NAME, camelize(object.parent->name),
+                                 camelize(std::format("send_{}", object.factory->name)), benchArgs(*object.factory, "objects.", ""), handlers);
+        else {
+            for (auto& child : OBJECTS) {
+                if (child.parent == object.iface)
+                    handlers += std::format("        {}->{}\n", OBJECT, factoryHandler(child, camelize(std::format("make_{}", child.iface->name))));
+            }
+
+            // children first, so the factory handlers of their parents can make them
+            makes = std::format(R"#(    static void {}(wl_client* client, uint32_t version, uint32_t id) {{
+        {} = new {}(client, version, id);
+        ++boundObjects;
+{}    }}
+
+)#",
+                                MAKE, OBJECT, CLASS_NAME, handlers) +
+                makes;
+
+            if (!object.parent)
+                binds += std::format("        wl_global_create(display, &{}_interface, {}, nullptr,\n                         [](wl_client* client, void*, uint32_t version, uint32_t id) {{ {}(client, version, id); }});\n",
+                                     iface.name, iface.version, MAKE);
+        }
+    }
+
+    for (size_t i = 0; i < SENT.size(); ++i) {
+        const auto& [iface, fn] = SENT[i];
+        const auto OBJECT       = "objects." + camelize(iface->name);
+        cases.format("            case {}:\n                {}->{}({});\n", i, OBJECT, camelize(std::format("send_{}", fn->name)), benchArgs(*fn, "objects.", ""));
+        if (coalesces(ctx, *iface, *fn))
+            cases.format("                {}->flushCoalesced();\n", OBJECT);
+        cases += "                break;\n";
+    }
+
+    auto& out = ctx.BENCH;
+    out += ctx.copyright;
+
+    if (!CLIENT) {
+        out.format(R"#(// The server half of the dispatch benchmark of {}, driven by {}-bench-client.cpp.
+
+#include "{}.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace HyprwaylandBench::{}::server {{
+    static wl_display* display      = nullptr;
+    static uint64_t    requests     = 0;
+    static size_t      boundObjects = 0;
+{}
+    // the object of each interface the client bound or created
+    static struct {{
+{}    }} objects;
+
+{}    void start(int fd) {{
+        display = wl_display_create();
+        wl_client_create(display, fd);
+
+{}    }}
+
+    void dispatch() {{
+        wl_event_loop_dispatch(wl_display_get_event_loop(display), 0);
+        wl_display_flush_clients(display);
+    }}
+
+    // the client has its objects once the server has them
+    size_t bound() {{
+        return boundObjects;
+    }}
+
+    uint64_t received() {{
+        return requests;
+    }}
+
+    void send(size_t event) {{
+        switch (event) {{
+{}        }}
+    }}
+
+    void stop() {{
+{}        wl_display_destroy_clients(display);
+        wl_display_destroy(display);
+    }}
+}}
+)#",
+                   ctx.PROTO_DATA.nameOriginal, FILE_NAME, FILE_NAME, NAME_SPACE, USES_ARR ? "    static wl_array    emptyArray   = {};\n" : "", members, makes, binds,
+                   cases.view(), deletes);
+        return;
+    }
+
+    out.format(R"#(// The dispatch benchmark of {}: a client and a server in one process, connected over a socketpair,
+// sending each message through the generated classes, and timing how many get through a second and how
+// long one takes to arrive. Ones with new_ids or fds, destructors, and ones that need objects of other
+// protocols are left out.
+//
+// Build it with {}-bench-server.cpp, the server code, and the client code generated with --no-interfaces,
+// and link wayland-server and wayland-client. Run it as <bench> [iterations] [message filter].
+// Define HYPRWAYLAND_SCANNER_BENCH_NO_MAIN to leave main() out and call HyprwaylandBench::{}::run() instead.
+
+#include "{}.hpp"
+#include <poll.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+namespace HyprwaylandBench::{} {{
+    // in {}-bench-server.cpp
+    namespace server {{
+        void     start(int fd);
+        void     dispatch();
+        size_t   bound();
+        uint64_t received();
+        void     send(size_t event);
+        void     stop();
+    }}
+
+    static wl_display* display = nullptr;
+    static uint64_t    events  = 0;
+{}
+    // the object of each interface, bound from the server's globals or created on another
+    static struct {{
+{}    }} objects;
+
+    // what's measured, in the order of sendRequest() and server::send()
+    static constexpr std::array<const char*, {}> REQUESTS = {{{}}};
+    static constexpr std::array<const char*, {}> EVENTS   = {{{}}};
+
+    static void sendRequest(size_t request) {{
+        switch (request) {{
+{}        }}
+    }}
+
+    static void onGlobal(void*, wl_registry* registry, uint32_t name, const char* interface, uint32_t version) {{
+{}    }}
+
+    static const wl_registry_listener registryListener = {{onGlobal, [](void*, wl_registry*, uint32_t) {{}}}};
+
+    // the objects no global gives, through the requests creating them on their parents
+    static void makeObjects() {{
+{}    }}
+
+    static uint64_t now() {{
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }}
+
+    // one round of both sides, without blocking
+    static void pump() {{
+        wl_display_flush(display);
+        server::dispatch();
+
+        while (wl_display_prepare_read(display) != 0) {{
+            wl_display_dispatch_pending(display);
+        }}
+
+        pollfd fd = {{wl_display_get_fd(display), POLLIN, 0}};
+        if (poll(&fd, 1, 0) > 0)
+            wl_display_read_events(display);
+        else
+            wl_display_cancel_read(display);
+
+        wl_display_dispatch_pending(display);
+
+        if (const auto ERROR = wl_display_get_error(display); ERROR != 0) {{
+            std::fprintf(stderr, "the connection broke: %s\n", std::strerror(ERROR));
+            std::exit(1);
+        }}
+    }}
+
+    struct SResult {{
+        double   perSecond = 0;
+        uint64_t p50       = 0;
+        uint64_t p99       = 0;
+    }};
+
+    // the throughput over batches small enough for the socket buffers, then the latency of one at a time
+    template <typename FSend, typename FReceived>
+    static SResult measure(size_t iterations, FSend&& send, FReceived&& received) {{
+        constexpr size_t BATCH = 64;
+
+        SResult          result;
+        const auto       BASE  = received();
+        const auto       START = now();
+        for (size_t sent = 0; sent < iterations;) {{
+            for (size_t i = 0; i < BATCH && sent < iterations; ++i, ++sent) {{
+                send();
+            }}
+            while (received() - BASE < sent) {{
+                pump();
+            }}
+        }}
+        result.perSecond = iterations * 1e9 / std::max<uint64_t>(now() - START, 1);
+
+        std::vector<uint64_t> latencies(std::min<size_t>(iterations, 10000));
+        for (auto& latency : latencies) {{
+            const auto BEFORE = received();
+            const auto SENT   = now();
+            send();
+            while (received() == BEFORE) {{
+                pump();
+            }}
+            latency = now() - SENT;
+        }}
+
+        std::sort(latencies.begin(), latencies.end());
+        if (!latencies.empty()) {{
+            result.p50 = latencies[latencies.size() / 2];
+            result.p99 = latencies[latencies.size() * 99 / 100];
+        }}
+        return result;
+    }}
+
+    static void print(const char* kind, const char* message, const SResult& result) {{
+        std::printf("%-8s %-48s %14.0f %10llu %10llu\n", kind, message, result.perSecond, (unsigned long long)result.p50, (unsigned long long)result.p99);
+    }}
+
+    int run(int argc, char** argv) {{
+        const size_t ITERATIONS = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+        const char*  FILTER     = argc > 2 ? argv[2] : "";
+
+        int          fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {{
+            std::perror("socketpair");
+            return 1;
+        }}
+
+        server::start(fds[0]);
+        display = wl_display_connect_to_fd(fds[1]);
+        if (!display) {{
+            std::perror("wl_display_connect_to_fd");
+            return 1;
+        }}
+
+        const auto REGISTRY = wl_display_get_registry(display);
+        wl_registry_add_listener(REGISTRY, &registryListener, nullptr);
+        while (server::bound() < {}) {{
+            pump();
+        }}
+
+        makeObjects();
+        while (server::bound() < {}) {{
+            pump();
+        }}
+
+        std::printf("{}: %zu of each message\n\n%-8s %-48s %14s %10s %10s\n", ITERATIONS, "", "message", "messages/s", "p50 ns", "p99 ns");
+
+        for (size_t i = 0; i < REQUESTS.size(); ++i) {{
+            if (std::strstr(REQUESTS[i], FILTER))
+                print("request", REQUESTS[i], measure(ITERATIONS, [i] {{ sendRequest(i); }}, server::received));
+        }}
+
+        for (size_t i = 0; i < EVENTS.size(); ++i) {{
+            if (std::strstr(EVENTS[i], FILTER))
+                print("event", EVENTS[i], measure(ITERATIONS, [i] {{ server::send(i); }}, [] {{ return events; }}));
+        }}
+
+        // the client first, as its destructors may still send requests
+{}        wl_registry_destroy(REGISTRY);
+        wl_display_disconnect(display);
+        server::stop();
+        return 0;
+    }}
+}}
+
+#ifndef HYPRWAYLAND_SCANNER_BENCH_NO_MAIN
+int main(int argc, char** argv) {{
+    return HyprwaylandBench::{}::run(argc, argv);
+}}
+#endif
+)#",
+               ctx.PROTO_DATA.nameOriginal, FILE_NAME, NAME_SPACE, FILE_NAME, NAME_SPACE, FILE_NAME, USES_ARR ? "    static wl_array    emptyArray = {};\n" : "", members,
+               requests.size(), benchNames(requests), events.size(), benchNames(events), cases.view(), binds, makes, GLOBALS, OBJECTS.size(), ctx.PROTO_DATA.nameOriginal, deletes,
+               NAME_SPACE);
+}
+
+// --loadgen: a server stub and a client driving it over its unix socket with many connections,
+// each its own executable, so the server's CPU time is its own
+void HyprwaylandScanner::writeLoadgen(SGenerationContext& ctx) {
+    const auto& FILE_NAME  = ctx.PROTO_DATA.fileName;
+    const auto& NAME       = ctx.PROTO_DATA.nameOriginal;
+    const auto  NAME_SPACE = identifier(NAME);
+    const auto  OBJECTS    = benchObjects(ctx);
+    const auto  requests   = benchMessages(ctx, true);
+
+    // the server counts through the setX() handlers, which the static dispatch templates never call.
+    // The client only sends
+    if (ctx.options.staticDispatch && !ctx.options.clientCode)
+        throw std::runtime_error("the load generator server can't be generated with static dispatch");
+
+    auto&       out = ctx.LOADGEN;
+    out += ctx.copyright;
+
+    if (!ctx.options.clientCode) {
+        std::string makes, globals;
+        for (auto& object : OBJECTS) {
+            const auto& iface      = *object.iface;
+            const auto  CLASS_NAME = camelize(std::format("C_{}", iface.name));
+            const auto  MAKE       = camelize(std::format("make_{}", iface.name));
+
+            std::string handlers;
+            for (auto& rq : iface.requests) {
+                if (rq.destructor)
+                    handlers += std::format("        RESOURCE->{}([]({}* self, auto...) {{ delete self; }});\n", camelize(std::format("set_{}", rq.name)), CLASS_NAME);
+            }
+            for (size_t i = 0; i < requests.size(); ++i) {
+                if (requests[i].first == &iface)
+                    handlers += std::format("        RESOURCE->{}([](auto...) {{ handled({}); }});\n", camelize(std::format("set_{}", requests[i].second->name)), i);
+            }
+            for (auto& child : OBJECTS) {
+                if (child.parent == object.iface)
+                    handlers += std::format("        RESOURCE->{}\n", factoryHandler(child, camelize(std::format("make_{}", child.iface->name))));
+            }
+
+            // children first, so the factory handlers of their parents can make them
+            makes = std::format(R"#(    static void {}(wl_client* client, uint32_t version, uint32_t id) {{
+        const auto RESOURCE = new {}(client, version, id);
+        RESOURCE->setOnDestroy([]({}* self) {{ delete self; }});
+{}    }}
+
+)#",
+                                MAKE, CLASS_NAME, CLASS_NAME, handlers) +
+                makes;
+
+            if (!object.parent)
+                globals += std::format("        wl_global_create(DISPLAY, &{}_interface, {}, nullptr,\n                         [](wl_client* client, void*, uint32_t version, uint32_t id) {{ {}(client, version, id); }});\n",
+                                       iface.name, iface.version, MAKE);
+        }
+
+        out.format(R"#(// The load generator server of {}: a global for every interface no new_id creates, and the objects of the others
+// made through the requests creating them, all of whose requests do nothing but count themselves and the CPU time they took,
+// driven by {}-loadgen-client.cpp. Build it with the server code and link wayland-server. Run it as <server> [socket name],
+// and it prints its report when interrupted or terminated.
+
+#include "{}.hpp"
+#include <sys/resource.h>
+#include <array>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+namespace HyprwaylandLoadgen::{} {{
+    // in the order of the client's
+    static constexpr std::array<const char*, {}> REQUESTS = {{{}}};
+
+    static std::array<uint64_t, REQUESTS.size()> counts  = {{}};
+    static std::array<uint64_t, REQUESTS.size()> cpu     = {{}};
+    static uint64_t                              lastCpu = 0;
+
+    static uint64_t threadCpu() {{
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }}
+
+    // each request gets the CPU time since the one before, so its share of reading and
+    // demarshalling them, and of the syncs the client times them with
+    {}static void handled(size_t request) {{
+        const auto NOW = threadCpu();
+        counts[request]++;
+        cpu[request] += NOW - lastCpu;
+        lastCpu = NOW;
+    }}
+
+    static void report() {{
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        uint64_t total = 0;
+        for (const auto COUNT : counts) {{
+            total += COUNT;
+        }}
+
+        std::printf("{} server: %llu requests, %.2f s of CPU\n\n%-48s %12s %16s\n", (unsigned long long)total,
+                    usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6, "request", "count", "CPU ns/request");
+        for (size_t i = 0; i < REQUESTS.size(); ++i) {{
+            if (counts[i] > 0)
+                std::printf("%-48s %12llu %16.0f\n", REQUESTS[i], (unsigned long long)counts[i], (double)cpu[i] / counts[i]);
+        }}
+        std::fflush(stdout);
+    }}
+
+{}    static int run(int argc, char** argv) {{
+        const char* SOCKET  = argc > 1 ? argv[1] : "hyprwayland-loadgen";
+        const auto  DISPLAY = wl_display_create();
+        if (wl_display_add_socket(DISPLAY, SOCKET) != 0) {{
+            std::fprintf(stderr, "couldn't listen on %s, is XDG_RUNTIME_DIR set?\n", SOCKET);
+            return 1;
+        }}
+
+{}
+        const auto LOOP      = wl_display_get_event_loop(DISPLAY);
+        const auto TERMINATE = [](int, void* display) {{
+            wl_display_terminate((wl_display*)display);
+            return 0;
+        }};
+        const auto SIGINT_SOURCE  = wl_event_loop_add_signal(LOOP, SIGINT, TERMINATE, DISPLAY);
+        const auto SIGTERM_SOURCE = wl_event_loop_add_signal(LOOP, SIGTERM, TERMINATE, DISPLAY);
+
+        lastCpu = threadCpu();
+        wl_display_run(DISPLAY);
+
+        report();
+        wl_event_source_remove(SIGINT_SOURCE);
+        wl_event_source_remove(SIGTERM_SOURCE);
+        wl_display_destroy_clients(DISPLAY);
+        wl_display_destroy(DISPLAY);
+        return 0;
+    }}
+}}
+
+int main(int argc, char** argv) {{
+    return HyprwaylandLoadgen::{}::run(argc, argv);
+}}
+)#",
+                   NAME, FILE_NAME, FILE_NAME, NAME_SPACE, requests.size(), benchNames(requests), requests.empty() ? "[[maybe_unused]] " : "", NAME, makes, globals, NAME_SPACE);
+        return;
+    }
+
+    std::string members, binds, makes, complete, deletes;
+    for (auto& object : OBJECTS) {
+        const auto& iface      = *object.iface;
+        const auto  CLASS_NAME = camelize(std::format("CC_{}", iface.name));
+        const auto  MEMBER     = camelize(iface.name);
+
+        members += std::format("        std::vector<{}*> {};\n", CLASS_NAME, MEMBER);
+        // children first, parents may not outlive them
+        deletes = std::format("            for (auto& object : c.{}) {{\n                delete object;\n            }}\n", MEMBER) + deletes;
+
+        if (object.parent) {
+            makes += std::format(R"#(        for (size_t i = 0; i < objectsPerInterface; ++i) {{
+            c.{}.emplace_back(new {}(c.{}[i]->{}({})));
+        }}
+)#",
+                                 MEMBER, CLASS_NAME, camelize(object.parent->name), camelize(std::format("send_{}", object.factory->name)),
+                                 benchArgs(*object.factory, "c.", "[i]"));
+            continue;
+        }
+
+        complete += std::format("{}!c.{}.empty()", complete.empty() ? "" : " && ", MEMBER);
+        binds += std::format(R"#(        if (std::strcmp(interface, "{}") == 0) {{
+            for (size_t i = 0; i < objectsPerInterface; ++i) {{
+                c.{}.emplace_back(new {}((wl_proxy*)wl_registry_bind(registry, name, &{}_interface, std::min<uint32_t>(version, {}))));
+            }}
+        }}
+)#",
+                             iface.name, MEMBER, CLASS_NAME, iface.name, iface.version);
+    }
+
+    CWriter cases;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const auto& [iface, fn] = requests[i];
+        const auto OBJECT       = std::format("c.{}[object]", camelize(iface->name));
+        cases.format("            case {}:\n                {}->{}({});\n", i, OBJECT, camelize(std::format("send_{}", fn->name)), benchArgs(*fn, "c.", "[object]"));
+        if (coalesces(ctx, *iface, *fn))
+            cases.format("                {}->flushCoalesced();\n", OBJECT);
+        cases += "                break;\n";
+    }
+
+    const auto MIX_EXAMPLE = requests.empty() ? std::string{"interface.request=2"} : std::format("{}.{}=2", requests.front().first->name, requests.front().second->name);
+    const bool USES_ARR    = std::any_of(requests.begin(), requests.end(), [](const auto& msg) {
+        return std::any_of(msg.second->args.begin(), msg.second->args.end(), [](const auto& arg) { return arg.wlType == "array"; });
+    });
+
+    out.format(R"#(// The load generator of {}: clients connecting to {}-loadgen-server over its unix socket, each binding or
+// creating a number of objects of every interface and sending them a weighted mix of requests at a target rate.
+// Every request is followed by a wl_display.sync, and the time until its done is the request's latency,
+// counted from when it was due rather than sent, so a server falling behind shows in the tail.
+// Build it with the client code and link wayland-client.
+
+#include "{}.hpp"
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace HyprwaylandLoadgen::{} {{
+    static constexpr const char* USAGE = R"(usage: %s [options]
+  --clients <n>          connections to open (16)
+  --objects <n>          objects of each interface per connection (4)
+  --rate <n>             requests per second per connection, 0 for as fast as it goes (1000)
+  --duration <s>         seconds to send for (10)
+  --mix <name=weight,..> requests to send and how often, like {} (all equally)
+  --socket <name>        the server's socket (hyprwayland-loadgen)
+  --server <path>        start the server, and stop it at the end to get its report
+)";
+
+    // in the order of the server's
+    static constexpr std::array<const char*, {}> REQUESTS = {{{}}};
+
+    // requests a connection has in flight at most, so the socket buffers never fill up
+    static constexpr size_t WINDOW = 64;
+
+    // log-linear, 16 buckets per power of two, so percentiles are off by 1/16 at most
+    struct SHistogram {{
+        std::array<uint64_t, 64 * 16> buckets = {{}};
+        uint64_t                      count   = 0;
+        uint64_t                      max     = 0;
+
+        void add(uint64_t ns) {{
+            const size_t EXP = ns < 16 ? 0 : std::bit_width(ns) - 4;
+            buckets[EXP * 16 + (EXP == 0 ? ns : (ns >> (EXP - 1)) - 16)]++;
+            count++;
+            max = std::max(max, ns);
+        }}
+
+        void merge(const SHistogram& other) {{
+            for (size_t i = 0; i < buckets.size(); ++i) {{
+                buckets[i] += other.buckets[i];
+            }}
+            count += other.count;
+            max = std::max(max, other.max);
+        }}
+
+        // the upper bound of the bucket it's in
+        uint64_t percentile(double p) const {{
+            const auto RANK = (uint64_t)(p * count);
+            uint64_t   seen = 0;
+            for (size_t i = 0; i < buckets.size(); ++i) {{
+                seen += buckets[i];
+                if (seen > RANK) {{
+                    const size_t EXP = i / 16, SUB = i % 16;
+                    return std::min<uint64_t>(max, EXP == 0 ? SUB : ((17 + SUB) << (EXP - 1)) - 1);
+                }}
+            }}
+            return max;
+        }}
+    }};
+
+    struct SConnection {{
+        wl_display*                             display  = nullptr;
+        wl_registry*                            registry = nullptr;
+{}        std::deque<std::pair<size_t, uint64_t>> inFlight; // request, when it was due
+        uint64_t                                nextSend = 0;
+        uint64_t                                random   = 0;
+    }};
+
+    static size_t                                  objectsPerInterface = 4;
+    static std::vector<uint64_t>                   cumulativeWeights;
+    static std::array<SHistogram, REQUESTS.size()> latencies;
+{}
+    static uint64_t now() {{
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }}
+
+    // xorshift, seeded per connection so runs repeat
+    static uint64_t next(SConnection& c) {{
+        c.random ^= c.random << 13;
+        c.random ^= c.random >> 7;
+        c.random ^= c.random << 17;
+        return c.random;
+    }}
+
+    static size_t pick(SConnection& c) {{
+        const auto ROLL = next(c) % cumulativeWeights.back();
+        return std::upper_bound(cumulativeWeights.begin(), cumulativeWeights.end(), ROLL) - cumulativeWeights.begin();
+    }}
+
+    static void send({}) {{
+        switch (request) {{
+{}        }}
+    }}
+
+    static void onGlobal(void* data, wl_registry* registry, uint32_t name, const char* interface, uint32_t version) {{
+        auto& c = *(SConnection*)data;
+{}    }}
+
+    static const wl_registry_listener registryListener = {{onGlobal, [](void*, wl_registry*, uint32_t) {{}}}};
+
+    // the objects no global gives, through the requests creating them on the ones of their parents
+    static void makeObjects({}) {{
+{}    }}
+
+    static const wl_callback_listener syncListener = {{[](void* data, wl_callback* callback, uint32_t) {{
+        auto&      c                = *(SConnection*)data;
+        const auto [REQUEST, DUE] = c.inFlight.front();
+        latencies[REQUEST].add(now() - DUE);
+        c.inFlight.pop_front();
+        wl_callback_destroy(callback);
+    }}}};
+
+    // weights from --mix, or all of them once
+    static bool parseMix(const std::string& mix) {{
+        std::vector<uint64_t> weights(REQUESTS.size(), mix.empty() ? 1 : 0);
+        for (size_t start = 0; start < mix.size();) {{
+            const auto END    = std::min(mix.find(',', start), mix.size());
+            const auto ENTRY  = mix.substr(start, END - start);
+            const auto EQUALS = ENTRY.find('=');
+            const auto NAME   = ENTRY.substr(0, EQUALS);
+            const auto IT     = std::find_if(REQUESTS.begin(), REQUESTS.end(), [&](const char* request) {{ return NAME == request; }});
+            if (IT == REQUESTS.end()) {{
+                std::fprintf(stderr, "no request %s to send\n", NAME.c_str());
+                return false;
+            }}
+
+            weights[IT - REQUESTS.begin()] = EQUALS == std::string::npos ? 1 : std::strtoull(ENTRY.c_str() + EQUALS + 1, nullptr, 10);
+            start                          = END + 1;
+        }}
+
+        uint64_t total = 0;
+        for (const auto WEIGHT : weights) {{
+            cumulativeWeights.emplace_back(total += WEIGHT);
+        }}
+
+        if (total == 0) {{
+            std::fprintf(stderr, "no requests to send\n");
+            return false;
+        }}
+        return true;
+    }}
+
+    static void print(const char* name, const SHistogram& latency, double seconds) {{
+        std::printf("%-48s %10llu %12.0f %10llu %10llu %10llu %10llu\n", name, (unsigned long long)latency.count, latency.count / seconds,
+                    (unsigned long long)latency.percentile(0.5), (unsigned long long)latency.percentile(0.99), (unsigned long long)latency.percentile(0.999),
+                    (unsigned long long)latency.max);
+    }}
+
+    static int run(int argc, char** argv) {{
+        size_t      clients  = 16;
+        uint64_t    rate     = 1000;
+        double      duration = 10;
+        std::string mix;
+        const char* socket = "hyprwayland-loadgen";
+        const char* server = nullptr;
+
+        for (int i = 1; i < argc; i += 2) {{
+            const std::string ARG = argv[i];
+            if (i + 1 >= argc) {{
+                std::fprintf(stderr, USAGE, argv[0]);
+                return 1;
+            }}
+
+            const char* VALUE = argv[i + 1];
+            if (ARG == "--clients")
+                clients = std::strtoull(VALUE, nullptr, 10);
+            else if (ARG == "--objects")
+                objectsPerInterface = std::max<size_t>(std::strtoull(VALUE, nullptr, 10), 1);
+            else if (ARG == "--rate")
+                rate = std::strtoull(VALUE, nullptr, 10);
+            else if (ARG == "--duration")
+                duration = std::strtod(VALUE, nullptr);
+            else if (ARG == "--mix")
+                mix = VALUE;
+            else if (ARG == "--socket")
+                socket = VALUE;
+            else if (ARG == "--server")
+                server = VALUE;
+            else {{
+                std::fprintf(stderr, USAGE, argv[0]);
+                return 1;
+            }}
+        }}
+
+        if (!parseMix(mix))
+            return 1;
+
+        pid_t serverPid = -1;
+        if (server) {{
+            serverPid = fork();
+            if (serverPid == 0) {{
+                execl(server, server, socket, nullptr);
+                std::perror(server);
+                _exit(1);
+            }}
+        }}
+
+        const auto STOP_SERVER = [&] {{
+            if (serverPid <= 0)
+                return;
+            std::fflush(stdout);
+            kill(serverPid, SIGTERM);
+            waitpid(serverPid, nullptr, 0);
+        }};
+
+        std::vector<SConnection> connections(clients);
+        for (size_t i = 0; i < clients; ++i) {{
+            auto& c = connections[i];
+
+            // a server we started may not be listening yet
+            for (int attempt = 0; !c.display && attempt < (server ? 500 : 1); ++attempt) {{
+                c.display = wl_display_connect(socket);
+                if (!c.display && server)
+                    usleep(10000);
+            }}
+
+            if (!c.display) {{
+                std::fprintf(stderr, "couldn't connect to %s\n", socket);
+                STOP_SERVER();
+                return 1;
+            }}
+
+            c.random   = 0x9E3779B97F4A7C15ULL * (i + 1);
+            c.registry = wl_display_get_registry(c.display);
+            wl_registry_add_listener(c.registry, &registryListener, &c);
+        }}
+
+        for (auto& c : connections) {{
+            wl_display_roundtrip(c.display);
+            if (!({})) {{
+                std::fprintf(stderr, "the server doesn't have all globals of {}, is it {}-loadgen-server?\n");
+                STOP_SERVER();
+                return 1;
+            }}
+
+            makeObjects(c);
+        }}
+
+        std::vector<pollfd> fds(clients);
+        const auto          INTERVAL = rate ? 1000000000ULL / rate : 0;
+        const auto          START    = now();
+        const auto          END      = START + (uint64_t)(duration * 1e9);
+        for (auto& c : connections) {{
+            c.nextSend = START;
+        }}
+
+        bool broken = false;
+        while (!broken) {{
+            const auto NOW     = now();
+            const bool SENDING = NOW < END;
+            bool       pending = false;
+            uint64_t   wake    = NOW + 10000000;
+
+            for (auto& c : connections) {{
+                while (SENDING && c.inFlight.size() < WINDOW && c.nextSend <= NOW) {{
+                    const auto REQUEST = pick(c);
+                    send(c, REQUEST, next(c) % objectsPerInterface);
+                    wl_callback_add_listener(wl_display_sync(c.display), &syncListener, &c);
+                    c.inFlight.emplace_back(REQUEST, rate ? c.nextSend : NOW);
+                    c.nextSend = rate ? c.nextSend + INTERVAL : NOW;
+                }}
+
+                wl_display_flush(c.display);
+                pending = pending || !c.inFlight.empty();
+                if (SENDING && c.inFlight.size() < WINDOW)
+                    wake = std::min(wake, c.nextSend);
+            }}
+
+            if (!SENDING && !pending)
+                break;
+
+            for (size_t i = 0; i < clients; ++i) {{
+                while (wl_display_prepare_read(connections[i].display) != 0) {{
+                    wl_display_dispatch_pending(connections[i].display);
+                }}
+                fds[i] = {{wl_display_get_fd(connections[i].display), POLLIN, 0}};
+            }}
+
+            const auto     WAIT    = wake > NOW ? wake - NOW : 0;
+            const timespec TIMEOUT = {{(time_t)(WAIT / 1000000000), (long)(WAIT % 1000000000)}};
+            ppoll(fds.data(), fds.size(), &TIMEOUT, nullptr);
+
+            for (size_t i = 0; i < clients; ++i) {{
+                auto& c = connections[i];
+                if (fds[i].revents & POLLIN)
+                    wl_display_read_events(c.display);
+                else
+                    wl_display_cancel_read(c.display);
+                wl_display_dispatch_pending(c.display);
+
+                if (const auto ERROR = wl_display_get_error(c.display); ERROR != 0 && !broken) {{
+                    std::fprintf(stderr, "connection %zu broke: %s\n", i, std::strerror(ERROR));
+                    broken = true;
+                }}
+            }}
+        }}
+
+        if (!broken) {{
+            const auto SECONDS = (END - START) / 1e9;
+            if (rate)
+                std::printf("{}: %zu clients with %zu objects of each interface, %llu requests/s each, for %.1f s\n\n", clients, objectsPerInterface,
+                            (unsigned long long)rate, SECONDS);
+            else
+                std::printf("{}: %zu clients with %zu objects of each interface, as fast as it goes, for %.1f s\n\n", clients, objectsPerInterface, SECONDS);
+            std::printf("%-48s %10s %12s %10s %10s %10s %10s\n", "request", "count", "requests/s", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+
+            SHistogram total;
+            for (size_t i = 0; i < REQUESTS.size(); ++i) {{
+                if (latencies[i].count == 0)
+                    continue;
+                print(REQUESTS[i], latencies[i], SECONDS);
+                total.merge(latencies[i]);
+            }}
+            print("all", total, SECONDS);
+            std::printf("\n");
+        }}
+
+        // objects first, their destructors may still send requests
+        for (auto& c : connections) {{
+{}            wl_registry_destroy(c.registry);
+            wl_display_flush(c.display);
+            wl_display_disconnect(c.display);
+        }}
+
+        STOP_SERVER();
+        return broken ? 1 : 0;
+    }}
+}}
+
+int main(int argc, char** argv) {{
+    return HyprwaylandLoadgen::{}::run(argc, argv);
+}}
+)#",
+               NAME, FILE_NAME, FILE_NAME, NAME_SPACE, MIX_EXAMPLE,
+               requests.size(), benchNames(requests), members, USES_ARR ? "    static wl_array                                emptyArray = {};\n" : "",
+               requests.empty() ? "SConnection&, size_t request, size_t" : "SConnection& c, size_t request, size_t object", cases.view(), binds,
+               makes.empty() ? "SConnection&" : "SConnection& c", makes, complete.empty() ? "true" : complete, NAME, FILE_NAME, NAME, NAME, deletes, NAME_SPACE);
+}
+
+std::string HyprwaylandScanner::moduleName(const SOptions& options, std::string_view name) {
+    return std::format("hyprwayland.{}.{}", options.clientCode ? "client" : "server", identifier(name));
+}
+
+// a module interface unit: what would be the header gets exported, what would be the source stays module-internal
+void HyprwaylandScanner::writeModule(SGenerationContext& ctx) {
+    ctx.MODULE.reserve(ctx.copyright.size() + ctx.HEADER.view().size() + ctx.SOURCE.view().size() + 4096);
+    ctx.MODULE += ctx.copyright;
+
+    // the delegate and pool can't go into the global module fragment, but they have to stay attached
+    // to the global module, or every protocol module would have its own
+    const auto SUPPORT = supportDefinitions(ctx.options);
+    ctx.MODULE.format(R"#(module;
+
+{}
+#include <cstdint>
+#include <string>
+{}
+
+export module {};
+{}
+#define F {}
+
+)#",
+                      handlerIncludes(ctx.options), (ctx.options.clientCode ? "#include <wayland-client.h>" : "#include <wayland-server.h>"),
+                      moduleName(ctx.options, ctx.PROTO_DATA.nameOriginal), (SUPPORT.empty() ? "" : std::format("\nextern \"C++\" {{{}}}\n", SUPPORT)),
+                      handlerType(ctx.options));
+
+    ctx.MODULE += ctx.HEADER.view();
+
+    ctx.MODULE += "\nextern \"C++\" {\n";
+    writeExterns(ctx.MODULE, referencedInterfaces(ctx));
+    ctx.MODULE += "}\n";
+
+    ctx.MODULE += ctx.SOURCE.view();
+    ctx.MODULE += "\n#undef F\n";
+}
+
+// mirrors the members every generated class has next to its handlers, see parseHeader()
+namespace {
+    struct SDelegateLayout {
+        unsigned char storage[sizeof(void*) * 2];
+        void*         invoke;
+    };
+
+    struct SServerClassLayout {
+        // onDestroy is counted with the handlers
+        void* pResource = nullptr;
+        struct {
+            void* link[2];
+            void* notify;
+            void* parent;
+        } resourceDestroyListener;
+        void* pData = nullptr;
+    };
+
+    struct SClientClassLayout {
+        void* pResource = nullptr;
+        bool  destroyed = false;
+        void* pData     = nullptr;
+    };
+}
+
+std::vector<SInterfaceStats> HyprwaylandScanner::interfaceStats(const SGenerationContext& ctx) {
+    std::vector<SInterfaceStats> stats;
+    stats.reserve(ctx.XMLDATA.ifaces.size());
+
+    for (auto& iface : ctx.XMLDATA.ifaces) {
+        SInterfaceStats ifaceStats;
+        ifaceStats.name          = iface.name;
+        ifaceStats.className     = camelize(std::format("{}{}", ctx.options.clientCode ? "CC_" : "C_", iface.name));
+        ifaceStats.handlers      = (ctx.options.clientCode ? iface.events : iface.requests).size();
+        const size_t HANDLERS    = ifaceStats.handlers + (ctx.options.clientCode ? 0 : 1);
+        size_t       size        = HANDLERS * (ctx.options.delegate ? sizeof(SDelegateLayout) : sizeof(std::function<void()>));
+
+        // the latest args of coalesced messages: a pending bool and 4-byte int, uint or fixed args each,
+        // then coalescedQueued. The other options only add statics
+        if (hasCoalesced(ctx, iface)) {
+            for (auto& fn : (ctx.options.clientCode ? iface.requests : iface.events)) {
+                if (!coalesces(ctx, iface, fn))
+                    continue;
+
+                size = fn.args.empty() ? size + 1 : (size + 3) / 4 * 4 + 4 + fn.args.size() * 4;
+            }
+
+            size++;
+        }
+
+        const size_t ALIGN       = alignof(void*);
+        ifaceStats.estimatedSize = (size + ALIGN - 1) / ALIGN * ALIGN + (ctx.options.clientCode ? sizeof(SClientClassLayout) : sizeof(SServerClassLayout));
+        stats.emplace_back(std::move(ifaceStats));
+    }
+
+    return stats;
+}
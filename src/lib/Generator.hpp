@@ -0,0 +1,130 @@
+#pragma once
+
+#include <hyprwayland-scanner/Scanner.hpp>
+#include <pugixml.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <format>
+
+// internals of libhyprwayland-scanner, shared between its sources
+namespace HyprwaylandScanner {
+    // the parsed IR. Names are views into the document, which was parsed in place
+    struct SRequestArgument {
+        std::string_view wlType;
+        std::string_view interface;
+        std::string_view enumName;
+        std::string_view name;
+        bool             newType   = false;
+        bool             allowNull = false;
+
+        // C types, resolved once after parsing by resolveTypes()
+        std::string cTypeRequest;
+        std::string cTypeEvent;
+        std::string cTypeEventRaw;
+    };
+
+    struct SWaylandFunction {
+        std::vector<SRequestArgument> args;
+        std::string_view              name;
+        std::string_view              since;
+        std::string_view              newIdType; // client only
+        bool                          destructor = false;
+        std::string                   signature; // resolved by resolveTypes()
+    };
+
+    struct SInterface {
+        std::vector<SWaylandFunction> requests;
+        std::vector<SWaylandFunction> events;
+        std::string_view              name;
+        int                           version = 1;
+    };
+
+    struct SEnum {
+        std::string                              name;
+        std::string_view                         nameOriginal;
+        std::vector<std::pair<std::string, int>> values;
+    };
+
+    // generated output, appended to in place instead of through temporaries
+    class CWriter {
+      public:
+        template <typename... Args>
+        void format(std::format_string<Args...> fmt, Args&&... args) {
+            std::format_to(std::back_inserter(buffer), fmt, std::forward<Args>(args)...);
+        }
+
+        CWriter& operator+=(std::string_view str) {
+            buffer.append(str);
+            return *this;
+        }
+
+        void reserve(size_t size) {
+            buffer.reserve(size);
+        }
+
+        std::string_view view() const {
+            return buffer;
+        }
+
+      private:
+        std::string buffer;
+    };
+
+    // all state for generating a single protocol, so that many protocols
+    // can be generated at once without stepping on each other
+    struct SGenerationContext {
+        SOptions options;
+
+        struct {
+            std::vector<SInterface>                      ifaces;
+            std::vector<SEnum>                           enums;
+
+            std::unordered_map<std::string_view, size_t> ifaceIndex; // name -> ifaces index
+            std::unordered_map<std::string_view, size_t> enumIndex;  // nameOriginal -> enums index, first one wins
+        } XMLDATA;
+
+        struct {
+            std::string      name;
+            std::string_view nameOriginal;
+            std::string      fileName;
+        } PROTO_DATA;
+
+        // the IR points into this
+        pugi::xml_document document;
+
+        std::string        copyright;
+
+        CWriter            HEADER;
+        CWriter            SOURCE;
+        CWriter            FWD_HEADER;
+        CWriter            MODULE;
+        CWriter            BENCH;   // --bench-harness
+        CWriter            LOADGEN; // --loadgen
+
+        // where each interface's code sits in SOURCE, so it can be split up
+        std::vector<std::pair<size_t, size_t>>       sourceSpans;
+        std::vector<std::pair<std::string, CWriter>> SOURCE_SHARDS; // file name, content
+    };
+
+    std::string                  camelize(std::string_view snake);
+
+    void                         parseXML(SGenerationContext& ctx, pugi::xml_document& doc);
+    void                         resolveTypes(SGenerationContext& ctx);
+
+    void                         parseFwdHeader(SGenerationContext& ctx);
+    void                         parseHeader(SGenerationContext& ctx);
+    void                         parseSource(SGenerationContext& ctx);
+    void                         writeModule(SGenerationContext& ctx);
+    void                         writeSourceShards(SGenerationContext& ctx);
+    void                         writeBenchHarness(SGenerationContext& ctx);
+    void                         writeLoadgen(SGenerationContext& ctx);
+
+    std::vector<std::string>     referencedInterfaces(const SGenerationContext& ctx);
+    void                         writeSourcePrologue(CWriter& out, const std::vector<std::string>& fileNames, const SOptions& options);
+    void                         writeExterns(CWriter& out, const std::vector<std::string>& ifaces);
+    std::string                  moduleName(const SOptions& options, std::string_view name);
+
+    std::vector<SInterfaceStats> interfaceStats(const SGenerationContext& ctx);
+}
@@ -0,0 +1,309 @@
+#include "Generator.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+#include <stdexcept>
+
+using namespace HyprwaylandScanner;
+
+struct HyprwaylandScanner::SProtocolImpl {
+    SGenerationContext ctx;
+    bool               headersDone = false;
+    bool               sourceDone  = false;
+
+    void               parse(std::span<char> xml, std::string_view fileName, const SOptions& options) {
+        ctx.options             = options;
+        ctx.PROTO_DATA.fileName = fileName;
+
+        if (xml.empty() || !ctx.document.load_buffer_inplace(xml.data(), xml.size()))
+            throw std::runtime_error("couldn't parse the xml");
+
+        ctx.PROTO_DATA.nameOriginal = ctx.document.child("protocol").attribute("name").as_string();
+        ctx.PROTO_DATA.name         = camelize(ctx.PROTO_DATA.nameOriginal);
+
+        ctx.copyright =
+            std::format("// Generated with hyprwayland-scanner {}. Made with vaxry's keyboard and ❤️.\n// {}\n\n/*\n This protocol's authors' copyright notice is:\n\n{}\n*/\n\n",
+                        SCANNER_VERSION, ctx.PROTO_DATA.nameOriginal, std::string{ctx.document.child("protocol").child("copyright").child_value()});
+
+        // generated code is a few times the size of the xml, save most of the regrowing
+        ctx.HEADER.reserve(ctx.copyright.size() + xml.size() * 2);
+        ctx.SOURCE.reserve(ctx.copyright.size() + xml.size() * 4);
+        if (!ctx.options.module) {
+            ctx.HEADER += ctx.copyright;
+            ctx.SOURCE += ctx.copyright;
+        }
+        if (ctx.options.fwdHeader)
+            ctx.FWD_HEADER += ctx.copyright;
+
+        parseXML(ctx, ctx.document);
+        resolveTypes(ctx);
+    }
+};
+
+// all files generated for a protocol, and what goes in them if there is a context yet
+static std::vector<std::pair<std::string, const CWriter*>> outputFiles(std::string_view fileName, const SOptions& options, const SGenerationContext* ctx) {
+    if (options.module)
+        return {{std::format("{}.cppm", fileName), ctx ? &ctx->MODULE : nullptr}};
+
+    std::vector<std::pair<std::string, const CWriter*>> files = {{std::format("{}.hpp", fileName), ctx ? &ctx->HEADER : nullptr}};
+
+    // amalgamated sources are written by amalgamate()
+    if (!options.amalgamated && options.sourceShards == 1)
+        files.emplace_back(std::format("{}.cpp", fileName), ctx ? &ctx->SOURCE : nullptr);
+    else if (!options.amalgamated && ctx) {
+        for (auto& [name, content] : ctx->SOURCE_SHARDS) {
+            files.emplace_back(name, &content);
+        }
+    } else if (!options.amalgamated) {
+        // one per interface needs the protocol for its names
+        for (size_t i = 0; i < options.sourceShards; ++i) {
+            files.emplace_back(std::format("{}-{}.cpp", fileName, i), nullptr);
+        }
+    }
+
+    if (options.fwdHeader)
+        files.emplace_back(std::format("{}-fwd.hpp", fileName), ctx ? &ctx->FWD_HEADER : nullptr);
+
+    if (options.benchHarness)
+        files.emplace_back(std::format("{}-bench-{}.cpp", fileName, options.clientCode ? "client" : "server"), ctx ? &ctx->BENCH : nullptr);
+
+    if (options.loadgen)
+        files.emplace_back(std::format("{}-loadgen-{}.cpp", fileName, options.clientCode ? "client" : "server"), ctx ? &ctx->LOADGEN : nullptr);
+
+    return files;
+}
+
+CProtocol::CProtocol(std::span<char> xml, std::string_view fileName, const SOptions& options) : impl(std::make_unique<SProtocolImpl>()) {
+    impl->parse(xml, fileName, options);
+}
+
+CProtocol::CProtocol(std::string xml, std::string_view fileName, const SOptions& options) : ownedXml(std::move(xml)), impl(std::make_unique<SProtocolImpl>()) {
+    impl->parse(ownedXml, fileName, options);
+}
+
+CProtocol::~CProtocol() = default;
+
+std::string_view CProtocol::name() const {
+    return impl->ctx.PROTO_DATA.nameOriginal;
+}
+
+std::string_view CProtocol::fileName() const {
+    return impl->ctx.PROTO_DATA.fileName;
+}
+
+const SOptions& CProtocol::options() const {
+    return impl->ctx.options;
+}
+
+void CProtocol::generateHeaders() {
+    if (impl->headersDone)
+        return;
+
+    if (impl->ctx.options.fwdHeader)
+        parseFwdHeader(impl->ctx);
+    parseHeader(impl->ctx);
+
+    impl->headersDone = true;
+}
+
+void CProtocol::generateSource() {
+    if (impl->sourceDone)
+        return;
+
+    parseSource(impl->ctx);
+
+    // a module is both in one
+    if (impl->ctx.options.module) {
+        generateHeaders();
+        writeModule(impl->ctx);
+    } else if (!impl->ctx.options.amalgamated && impl->ctx.options.sourceShards != 1)
+        writeSourceShards(impl->ctx);
+
+    if (impl->ctx.options.benchHarness && !impl->ctx.options.module)
+        writeBenchHarness(impl->ctx);
+    if (impl->ctx.options.loadgen && !impl->ctx.options.module)
+        writeLoadgen(impl->ctx);
+
+    impl->sourceDone = true;
+}
+
+void CProtocol::generate() {
+    generateHeaders();
+    generateSource();
+}
+
+std::string_view CProtocol::header() const {
+    return impl->ctx.HEADER.view();
+}
+
+std::string_view CProtocol::source() const {
+    return impl->ctx.SOURCE.view();
+}
+
+std::string_view CProtocol::fwdHeader() const {
+    return impl->ctx.FWD_HEADER.view();
+}
+
+std::string_view CProtocol::module() const {
+    return impl->ctx.MODULE.view();
+}
+
+std::vector<std::pair<std::string, std::string_view>> CProtocol::files() const {
+    std::vector<std::pair<std::string, std::string_view>> files;
+    for (auto& [name, content] : outputFiles(impl->ctx.PROTO_DATA.fileName, impl->ctx.options, &impl->ctx)) {
+        files.emplace_back(name, content->view());
+    }
+    return files;
+}
+
+bool CProtocol::write(const std::function<bool(const std::string& name, std::string_view content)>& sink) const {
+    for (auto& [name, content] : outputFiles(impl->ctx.PROTO_DATA.fileName, impl->ctx.options, &impl->ctx)) {
+        if (!sink(name, content->view()))
+            return false;
+    }
+    return true;
+}
+
+std::vector<SInterfaceStats> CProtocol::interfaceStats() const {
+    return HyprwaylandScanner::interfaceStats(impl->ctx);
+}
+
+std::vector<std::string> HyprwaylandScanner::outputNames(std::string_view fileName, const SOptions& options) {
+    std::vector<std::string> names;
+    for (auto& [name, content] : outputFiles(fileName, options, nullptr)) {
+        names.emplace_back(name);
+    }
+    return names;
+}
+
+// the umbrella header first, then the source shards
+std::vector<std::string> HyprwaylandScanner::amalgamationNames(std::string_view name, size_t shards, const SOptions& options) {
+    // modules carry their code, so there's only an umbrella module
+    if (options.module)
+        return {std::format("{}.cppm", name)};
+
+    std::vector<std::string> names = {std::format("{}.hpp", name)};
+
+    if (shards <= 1)
+        names.emplace_back(std::format("{}.cpp", name));
+    else {
+        for (size_t i = 0; i < shards; ++i) {
+            names.emplace_back(std::format("{}-{}.cpp", name, i));
+        }
+    }
+
+    return names;
+}
+
+// One umbrella header including every protocol header, and the generated code of all
+// protocols in one TU (or a few shards of similar size) sharing the includes and externs.
+std::vector<std::pair<std::string, std::string>> HyprwaylandScanner::amalgamate(const std::vector<const CProtocol*>& protocols, std::string_view name, size_t shards) {
+    if (protocols.empty())
+        return {};
+
+    const auto& OPTIONS = protocols.front()->options();
+    const auto  NAMES   = amalgamationNames(name, shards, OPTIONS);
+
+    if (OPTIONS.module) {
+        CWriter umbrella;
+        umbrella.format("// Generated with hyprwayland-scanner {}. Made with vaxry's keyboard and ❤️.\n// amalgamation of {} protocols\n\nexport module {};\n\n", SCANNER_VERSION,
+                        protocols.size(), moduleName(OPTIONS, name));
+        for (auto& protocol : protocols) {
+            umbrella.format("export import {};\n", moduleName(OPTIONS, protocol->name()));
+        }
+
+        return {{NAMES[0], std::string{umbrella.view()}}};
+    }
+
+    std::vector<std::pair<std::string, std::string>> files;
+
+    CWriter                                          header;
+    header.format("// Generated with hyprwayland-scanner {}. Made with vaxry's keyboard and ❤️.\n// amalgamation of {} protocols\n\n#pragma once\n\n", SCANNER_VERSION,
+                  protocols.size());
+    for (auto& protocol : protocols) {
+        header.format("#include \"{}.hpp\"\n", protocol->fileName());
+    }
+
+    files.emplace_back(NAMES[0], header.view());
+
+    // biggest first onto the smallest shard, then back to input order within each shard
+    std::vector<size_t> order(protocols.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return protocols[a]->source().size() > protocols[b]->source().size(); });
+
+    std::vector<std::vector<size_t>> shardIndices(NAMES.size() - 1);
+    std::vector<size_t>              shardSizes(shardIndices.size(), 0);
+    for (const auto IDX : order) {
+        const auto SMALLEST = std::min_element(shardSizes.begin(), shardSizes.end()) - shardSizes.begin();
+        shardIndices[SMALLEST].emplace_back(IDX);
+        shardSizes[SMALLEST] += protocols[IDX]->source().size();
+    }
+
+    for (size_t i = 0; i < shardIndices.size(); ++i) {
+        auto& shard = shardIndices[i];
+        std::sort(shard.begin(), shard.end());
+
+        std::vector<std::string>        fileNames;
+        std::vector<std::string>        externs;
+        std::unordered_set<std::string> seenExterns;
+        for (const auto IDX : shard) {
+            fileNames.emplace_back(protocols[IDX]->fileName());
+            for (auto& iface : referencedInterfaces(protocols[IDX]->impl->ctx)) {
+                if (seenExterns.emplace(iface).second)
+                    externs.emplace_back(iface);
+            }
+        }
+
+        CWriter source;
+        source.reserve(shardSizes[i] + 4096);
+        source.format("// Generated with hyprwayland-scanner {}. Made with vaxry's keyboard and ❤️.\n// amalgamation of {} protocols, part {} of {}\n\n", SCANNER_VERSION,
+                      shard.size(), i + 1, shardIndices.size());
+
+        writeSourcePrologue(source, fileNames, OPTIONS);
+        writeExterns(source, externs);
+
+        for (const auto IDX : shard) {
+            source += "\n";
+            source += protocols[IDX]->source();
+        }
+
+        source += "\n#undef F\n";
+
+        files.emplace_back(NAMES[i + 1], source.view());
+    }
+
+    return files;
+}
+
+std::vector<std::string> HyprwaylandScanner::unknownCoalesced(const std::vector<std::string_view>& xmls, const SOptions& options) {
+    const auto SENT = options.clientCode ? "request" : "event";
+
+    std::unordered_set<std::string> known;
+    for (auto& xml : xmls) {
+        // a broken protocol fails when it's generated
+        pugi::xml_document document;
+        if (!document.load_buffer(xml.data(), xml.size()))
+            continue;
+
+        for (auto& iface : document.child("protocol").children("interface")) {
+            for (auto& message : iface.children(SENT)) {
+                known.emplace(std::format("{}.{}", iface.attribute("name").as_string(), message.attribute("name").as_string()));
+            }
+        }
+    }
+
+    std::vector<std::string> unknown;
+    for (auto& name : options.coalesce) {
+        if (!known.contains(name))
+            unknown.emplace_back(name);
+    }
+
+    return unknown;
+}
+
+std::string_view HyprwaylandScanner::version() {
+    return SCANNER_VERSION;
+}
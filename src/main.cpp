@@ -1,1069 +1,1172 @@
-#include <pugixml.hpp>
+#include <hyprwayland-scanner/Scanner.hpp>
 #include <iostream>
 #include <string>
 #include <fstream>
 #include <format>
 #include <vector>
 #include <algorithm>
-#include <tuple>
+#include <ranges>
 #include <filesystem>
-
-bool waylandEnums = false;
-bool clientCode   = false;
-bool noInterfaces = false;
-
-struct SRequestArgument {
-    std::string wlType;
-    std::string interface;
-    std::string enumName;
-    std::string name;
-    bool        newType   = false;
-    bool        allowNull = false;
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include <functional>
+#include <unordered_map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// what the library generates with, and what only the CLI does around it
+struct SCliOptions {
+    HyprwaylandScanner::SOptions generation;
+
+    bool                         force = false; // ignore stamps, always regenerate
+    bool                         stats = false; // collect per-phase timings, allocations and footprints while generating
+    bool                         watch = false; // keep running and regenerate protocols as they change
+
+    // generate all sources into one amalgamated source (or shards of it) with this name.
+    // Without, shards splits the source of each protocol.
+    std::string amalgamate;
+    size_t      shards = 1;
+
+    bool        splitSource = false; // one source per interface
+
+    // the files the messages to coalesce were read from
+    std::vector<std::string> coalesceFiles;
 };
 
-struct SWaylandFunction {
-    std::vector<SRequestArgument> args;
-    std::string                   name;
-    std::string                   since;
-    std::string                   newIdType  = ""; // client only
-    bool                          destructor = false;
+// a protocol mapped copy-on-write, so the parser can work in place
+class CMappedFile {
+  public:
+    CMappedFile()                              = default;
+    CMappedFile(const CMappedFile&)            = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    ~CMappedFile() {
+        unmap();
+    }
+
+    bool map(const std::string& path) {
+        unmap();
+
+        const int FD = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (FD < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(FD, &st) != 0 || st.st_size <= 0) {
+            close(FD);
+            return false;
+        }
+
+        void* mapped = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, FD, 0);
+        close(FD);
+
+        if (mapped == MAP_FAILED)
+            return false;
+
+        pData    = static_cast<char*>(mapped);
+        dataSize = st.st_size;
+        return true;
+    }
+
+    void unmap() {
+        if (pData)
+            munmap(pData, dataSize);
+        pData    = nullptr;
+        dataSize = 0;
+    }
+
+    char* data() {
+        return pData;
+    }
+
+    std::string_view view() const {
+        return {pData, dataSize};
+    }
+
+  private:
+    char*  pData    = nullptr;
+    size_t dataSize = 0;
 };
 
-struct SInterface {
-    std::vector<SWaylandFunction> requests;
-    std::vector<SWaylandFunction> events;
-    std::string                   name;
-    int                           version = 1;
+struct SPhaseStats {
+    uint64_t us         = 0;
+    long     maxRssKb   = 0; // process peak at the end of the phase
+    uint64_t allocs     = 0;
+    uint64_t allocBytes = 0;
 };
 
-struct SEnum {
-    std::string                              name;
-    std::string                              nameOriginal;
-    std::vector<std::pair<std::string, int>> values;
+// allocations made by the current thread. A protocol is generated on a single
+// thread, so the difference over a phase belongs to that protocol alone
+struct SAllocCounter {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
 };
 
-struct {
-    std::vector<SInterface> ifaces;
-    std::vector<SEnum>      enums;
-} XMLDATA;
+static thread_local SAllocCounter allocCounter;
+
+// only with --stats, so runs without it don't pay for the counting.
+// Set before any job starts and never after, so the threads read it without a race
+static bool countAllocations = false;
 
-const char* resourceName() {
-    return clientCode ? "wl_proxy" : "wl_resource";
+static void* allocate(size_t size, size_t alignment) {
+    if (countAllocations) {
+        allocCounter.count++;
+        allocCounter.bytes += size;
+    }
+
+    size = size ? size : 1;
+    if (void* ptr = alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? std::malloc(size) : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+        return ptr;
+
+    throw std::bad_alloc{};
 }
 
-std::string sanitize(const std::string& in) {
-    if (in == "namespace")
-        return "namespace_";
-    if (in == "class")
-        return "class_";
-    if (in == "delete")
-        return "delete_";
-    if (in == "new")
-        return "new_";
-    return in;
+// the whole set, so every allocation is counted and freed the way it was made. The nothrow ones
+// go through these by default. All kept out of line, or gcc sees malloc() paired with operator delete and warns
+[[gnu::noinline]] void* operator new(size_t size) {
+    return allocate(size, 0);
 }
 
-std::string argsToShort(std::vector<SRequestArgument>& args, const std::string& since) {
-    std::string shortt = since;
-    for (auto& a : args) {
-        if (a.wlType == "int")
-            shortt += "i";
-        else if (a.wlType == "new_id") {
-            if (a.interface.empty())
-                shortt += "su";
-            shortt += "n";
-        } else if (a.wlType == "uint")
-            shortt += "u";
-        else if (a.wlType == "fixed")
-            shortt += "f";
-        else if (a.wlType == "string")
-            shortt += std::string(a.allowNull ? "?s" : "s");
-        else if (a.wlType == "object")
-            shortt += std::string(a.allowNull ? "?" : "") + "o";
-        else if (a.wlType == "array")
-            shortt += "a";
-        else if (a.wlType == "fd")
-            shortt += "h";
-        else
-            throw std::runtime_error("Unknown arg in argsToShort");
-    }
-    return shortt;
+[[gnu::noinline]] void* operator new[](size_t size) {
+    return allocate(size, 0);
 }
 
-std::string camelize(std::string snake) {
-    std::string result = "";
-    for (size_t i = 0; i < snake.length(); ++i) {
-        if (snake[i] == '_' && i != 0 && i + 1 < snake.length() && snake[i + 1] != '_') {
-            result += ::toupper(snake[i + 1]);
-            i++;
-            continue;
-        }
+[[gnu::noinline]] void* operator new(size_t size, std::align_val_t alignment) {
+    return allocate(size, (size_t)alignment);
+}
 
-        result += snake[i];
-    }
+[[gnu::noinline]] void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocate(size, (size_t)alignment);
+}
 
-    return result;
+[[gnu::noinline]] void operator delete(void* ptr) noexcept {
+    std::free(ptr);
 }
 
-std::string WPTypeToCType(const SRequestArgument& arg, bool event /* events pass iface ptrs, requests ids */, bool ignoreTypes = false /* for dangerous */) {
-    if (arg.wlType == "uint" || arg.wlType == "new_id") {
-        if (arg.enumName.empty() && arg.interface.empty())
-            return "uint32_t";
+[[gnu::noinline]] void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
 
-        // enum
-        if (!arg.enumName.empty()) {
-            for (auto& e : XMLDATA.enums) {
-                if (e.nameOriginal == arg.enumName)
-                    return e.name;
-            }
-            return "uint32_t";
-        }
+[[gnu::noinline]] void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
 
-        if (!event && clientCode && arg.wlType == "new_id")
-            return "wl_proxy*";
+[[gnu::noinline]] void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
 
-        // iface
-        if (!arg.interface.empty() && event) {
-            for (auto& i : XMLDATA.ifaces) {
-                if (i.name == arg.interface)
-                    return camelize((clientCode ? "CC_" : "C_") + arg.interface + "*");
-            }
-            return std::string{resourceName()} + "*";
-        }
+[[gnu::noinline]] void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
 
-        return "uint32_t";
-    }
-    if (arg.wlType == "object") {
-        if (!arg.interface.empty() && event && !ignoreTypes) {
-            for (auto& i : XMLDATA.ifaces) {
-                if (i.name == arg.interface)
-                    return camelize((clientCode ? "CC_" : "C_") + arg.interface + "*");
-            }
-        }
-        return std::string{resourceName()} + "*";
-    }
-    if (arg.wlType == "int" || arg.wlType == "fd")
-        return "int32_t";
-    if (arg.wlType == "fixed")
-        return "wl_fixed_t";
-    if (arg.wlType == "array")
-        return "wl_array*";
-    if (arg.wlType == "string")
-        return "const char*";
-    throw std::runtime_error("unknown wp type");
-    return "";
+[[gnu::noinline]] void operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
 }
 
-std::string HEADER;
-std::string SOURCE;
+[[gnu::noinline]] void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
 
-struct {
-    std::string name;
-    std::string nameOriginal;
+// all state for generating a single protocol, so that many protocols
+// can be generated at once without stepping on each other
+struct SProtocolContext {
+    SCliOptions options;
+    std::string protoPath;
     std::string fileName;
-} PROTO_DATA;
-
-void parseXML(pugi::xml_document& doc) {
-
-    for (auto& ge : doc.child("protocol").children("enum")) {
-        SEnum enum_;
-        enum_.nameOriginal = ge.attribute("name").as_string();
-        enum_.name         = waylandEnums ? "enum " + PROTO_DATA.name + "_" + enum_.nameOriginal : camelize(PROTO_DATA.name + "_" + enum_.nameOriginal);
-        for (auto& entry : ge.children("entry")) {
-            auto VALUENAME = enum_.nameOriginal + "_" + entry.attribute("name").as_string();
-            std::transform(VALUENAME.begin(), VALUENAME.end(), VALUENAME.begin(), ::toupper);
-            enum_.values.emplace_back(std::make_pair<>(VALUENAME, entry.attribute("value").as_int()));
-        }
-        XMLDATA.enums.push_back(enum_);
+
+    // the protocol is parsed in place from input, so that has to outlive it
+    CMappedFile                                    input;
+    std::unique_ptr<HyprwaylandScanner::CProtocol> protocol;
+
+    // set if generation failed, reported after all jobs finish
+    std::string error;
+    std::string stamp;
+
+    // names of the generated files, from the stamp if they were up to date
+    std::vector<std::string> outputs;
+
+    struct {
+        SPhaseStats                                     load, parse, header, source, write;
+        bool                                            upToDate = false;
+        std::vector<std::pair<std::string, size_t>>     outputs; // path, bytes
+        std::vector<HyprwaylandScanner::SInterfaceStats> interfaces;
+    } stats;
+};
+
+// FNV-1a, plenty for telling whether an input changed
+uint64_t hashBytes(std::string_view data) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : data) {
+        hash ^= (unsigned char)c;
+        hash *= 0x100000001b3ULL;
     }
+    return hash;
+}
 
-    for (auto& iface : doc.child("protocol").children("interface")) {
-        SInterface ifc;
-        ifc.name    = iface.attribute("name").as_string();
-        ifc.version = iface.attribute("version").as_int();
-
-        for (auto& en : iface.children("enum")) {
-            SEnum enum_;
-            enum_.nameOriginal = en.attribute("name").as_string();
-            enum_.name         = waylandEnums ? "enum " + ifc.name + "_" + enum_.nameOriginal : camelize(ifc.name + "_" + enum_.nameOriginal);
-            for (auto& entry : en.children("entry")) {
-                auto VALUENAME = ifc.name + "_" + enum_.nameOriginal + "_" + entry.attribute("name").as_string();
-                std::transform(VALUENAME.begin(), VALUENAME.end(), VALUENAME.begin(), ::toupper);
-                enum_.values.emplace_back(std::make_pair<>(VALUENAME, entry.attribute("value").as_int()));
-            }
-            XMLDATA.enums.push_back(enum_);
-        }
+// every option that affects the generated output has to be in here
+std::string optionsKey(const SCliOptions& options) {
+    const auto& GEN = options.generation;
 
-        for (auto& rq : iface.children("request")) {
-            SWaylandFunction srq;
-            srq.name       = rq.attribute("name").as_string();
-            srq.since      = rq.attribute("since").as_string();
-            srq.destructor = rq.attribute("type").as_string() == std::string{"destructor"};
-
-            for (auto& arg : rq.children("arg")) {
-                SRequestArgument sargm;
-                if (arg.attribute("type").as_string() == std::string{"new_id"} && clientCode)
-                    srq.newIdType = arg.attribute("interface").as_string();
-
-                sargm.newType   = arg.attribute("type").as_string() == std::string{"new_id"} && clientCode;
-                sargm.name      = sanitize(arg.attribute("name").as_string());
-                sargm.wlType    = arg.attribute("type").as_string();
-                sargm.interface = arg.attribute("interface").as_string();
-                sargm.enumName  = arg.attribute("enum").as_string();
-                sargm.allowNull = arg.attribute("allow-null").as_string() == std::string{"true"};
-
-                srq.args.push_back(sargm);
-            }
+    std::string coalesce;
+    for (auto& name : GEN.coalesce) {
+        coalesce += (coalesce.empty() ? "" : ",") + name;
+    }
 
-            ifc.requests.push_back(srq);
-        }
+    return std::format(
+        "client={} wayland-enums={} no-interfaces={} fwd-header={} amalgamate={} module={} source-shards={} delegate={} static-dispatch={} pool={} marshal-array={} broadcast={} event-queues={} instrument={} record={} bench-harness={} loadgen={} coalesce={}",
+        (int)GEN.clientCode, (int)GEN.waylandEnums, (int)GEN.noInterfaces, (int)GEN.fwdHeader, (int)GEN.amalgamated, (int)GEN.module, GEN.sourceShards, (int)GEN.delegate,
+        (int)GEN.staticDispatch, (int)GEN.pool, (int)GEN.marshalArray, (int)GEN.broadcast, (int)GEN.eventQueues, (int)GEN.instrument, (int)GEN.record, (int)GEN.benchHarness,
+        (int)GEN.loadgen, coalesce);
+}
 
-        for (auto& ev : iface.children("event")) {
-            SWaylandFunction sev;
-            sev.name       = ev.attribute("name").as_string();
-            sev.since      = ev.attribute("since").as_string();
-            sev.destructor = ev.attribute("type").as_string() == std::string{"destructor"};
-
-            for (auto& arg : ev.children("arg")) {
-                SRequestArgument sargm;
-                sargm.name      = sanitize(arg.attribute("name").as_string());
-                sargm.interface = arg.attribute("interface").as_string();
-                sargm.wlType    = arg.attribute("type").as_string();
-                sargm.enumName  = arg.attribute("enum").as_string();
-                sargm.allowNull = arg.attribute("allow-null").as_string() == std::string{"true"};
-
-                sev.args.push_back(sargm);
-            }
+std::string stampFor(const SProtocolContext& ctx, std::string_view xml) {
+    return std::format("{:016x} {} {}\n", hashBytes(xml), SCANNER_VERSION, optionsKey(ctx.options));
+}
 
-            ifc.events.push_back(sev);
-        }
+std::string stampPath(const SProtocolContext& ctx, const std::string& outpath) {
+    return outpath + "/" + ctx.fileName + ".hws-stamp";
+}
 
-        XMLDATA.ifaces.push_back(ifc);
+// all files generated for a protocol. Sources split per interface are only known once generated.
+std::vector<std::string> outputPaths(const SProtocolContext& ctx, const std::string& outpath) {
+    auto paths = ctx.outputs.empty() ? HyprwaylandScanner::outputNames(ctx.fileName, ctx.options.generation) : ctx.outputs;
+    for (auto& path : paths) {
+        path = outpath + "/" + path;
     }
+    return paths;
 }
 
-void parseHeader() {
+// a stamp is the line from stampFor(), followed by the names of the files it generated
+bool readStamp(const std::string& path, std::string& stamp, std::vector<std::string>& outputs) {
+    std::ifstream stampIn(path);
+    if (!stampIn.good())
+        return false;
 
-    // add some boilerplate
-    HEADER +=
-        std::format(R"#(#pragma once
+    if (!std::getline(stampIn, stamp))
+        return false;
+    stamp += "\n";
 
-#include <functional>
-#include <cstdint>
-#include <string>
-{}
+    std::string output;
+    while (std::getline(stampIn, output)) {
+        if (!output.empty())
+            outputs.emplace_back(output);
+    }
 
-#define F std::function
+    return true;
+}
 
-{}
+// the outputs are up to date if the stamp next to them matches and none of them went missing
+bool isUpToDate(SProtocolContext& ctx, const std::string& outpath, const std::string& stamp) {
+    std::string              oldStamp;
+    std::vector<std::string> oldOutputs;
+    if (!readStamp(stampPath(ctx, outpath), oldStamp, oldOutputs) || oldStamp != stamp)
+        return false;
 
-)#",
-                    (clientCode ? "#include <wayland-client.h>" : "#include <wayland-server.h>"), (clientCode ? "struct wl_proxy;" : "struct wl_client;\nstruct wl_resource;"));
+    ctx.outputs = std::move(oldOutputs);
 
-    // parse all enums
-    if (!waylandEnums) {
-        for (auto& en : XMLDATA.enums) {
-            HEADER += std::format("enum {} : uint32_t {{\n", en.name);
-            for (auto& [k, v] : en.values) {
-                HEADER += std::format("    {} = {},\n", k, v);
-            }
-            HEADER += "};\n\n";
-        }
+    for (auto& path : outputPaths(ctx, outpath)) {
+        if (!std::filesystem::exists(path))
+            return false;
     }
 
-    // fw declare all classes
-    for (auto& iface : XMLDATA.ifaces) {
-        const auto IFACE_CLASS_NAME_CAMEL = camelize((clientCode ? "CC_" : "C_") + iface.name);
-        HEADER += std::format("\nclass {};", IFACE_CLASS_NAME_CAMEL);
+    return true;
+}
 
-        for (auto& rq : iface.requests) {
-            for (auto& arg : rq.args) {
-                if (!arg.interface.empty()) {
-                    HEADER += std::format("\nclass {};", camelize((clientCode ? "CC_" : "C_") + arg.interface));
-                }
-            }
-        }
+// whether the file at path has exactly this content. Bails at the first difference.
+bool fileMatches(const std::string& path, std::string_view content) {
+    const int FD = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (FD < 0)
+        return false;
 
-        for (auto& rq : iface.events) {
-            for (auto& arg : rq.args) {
-                if (!arg.interface.empty()) {
-                    HEADER += std::format("\nclass {};", camelize((clientCode ? "CC_" : "C_") + arg.interface));
-                }
-            }
-        }
+    struct stat st;
+    if (fstat(FD, &st) != 0 || (size_t)st.st_size != content.size()) {
+        close(FD);
+        return false;
     }
 
-    HEADER += "\n\n#ifndef HYPRWAYLAND_SCANNER_NO_INTERFACES\n";
+    if (content.empty()) {
+        close(FD);
+        return true;
+    }
 
-    for (auto& iface : XMLDATA.ifaces) {
-        const auto IFACE_WL_NAME       = iface.name + "_interface";
-        const auto IFACE_WL_NAME_CAMEL = camelize(iface.name + "_interface");
+    void* data = mmap(nullptr, content.size(), PROT_READ, MAP_PRIVATE, FD, 0);
+    close(FD);
 
-        HEADER += std::format("extern const wl_interface {};\n", IFACE_WL_NAME, IFACE_WL_NAME_CAMEL, IFACE_WL_NAME);
-    }
+    if (data == MAP_FAILED)
+        return false;
+
+    const bool MATCHES = std::memcmp(data, content.data(), content.size()) == 0;
+    munmap(data, content.size());
 
-    HEADER += "\n#endif\n";
+    return MATCHES;
+}
 
-    for (auto& iface : XMLDATA.ifaces) {
-        const auto IFACE_NAME_CAMEL       = camelize(iface.name);
-        const auto IFACE_CLASS_NAME_CAMEL = camelize((clientCode ? "CC_" : "C_") + iface.name);
+// writes the file only if its content differs, keeping the mtime otherwise.
+// Goes through a temp file + rename, so nobody ever sees a half-written file.
+bool writeIfChanged(const std::string& path, std::string_view content) {
+    if (fileMatches(path, content))
+        return true;
 
-        if (!clientCode) {
-            HEADER += std::format(R"#(
-struct {}DestroyWrapper {{
-    wl_listener listener;
-    {}* parent = nullptr;
-}};
-            )#",
-                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
-        }
+    const auto TMPPATH = std::format("{}.{}.{}.tmp", path, getpid(), std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
-        // begin the class
-        HEADER +=
-            std::format(R"#(
+    const int  FD = open(TMPPATH.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (FD < 0)
+        return false;
 
-class {} {{
-  public:
-    {}({});
-    ~{}();
-
-)#",
-                        IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, (clientCode ? "wl_proxy*" : "wl_client* client, uint32_t version, uint32_t id"), IFACE_CLASS_NAME_CAMEL);
-
-        if (!clientCode) {
-            HEADER += std::format(R"#(
-    // set a listener for when this resource is _being_ destroyed
-    void setOnDestroy(F<void({}*)> &&handler) {{
-        onDestroy = std::move(handler);
-    }}
-
-    // set the data for this resource
-    void setData(void* data) {{
-        pData = data;
-    }}
-
-    // get the data for this resource
-    void* data() {{
-        return pData;
-    }}
-
-    // get the raw wl_resource ptr
-    wl_resource* resource() {{
-        return pResource;
-    }}
-
-    // get the client
-    wl_client* client() {{
-        return wl_resource_get_client(pResource);
-    }}
-
-    // send an error
-    void error(uint32_t error, const std::string& message) {{
-        wl_resource_post_error(pResource, error, "%s", message.c_str());
-    }}
-
-    // send out of memory
-    void noMemory() {{
-        wl_resource_post_no_memory(pResource);
-    }}
-
-    // get the resource version
-    int version() {{
-        return wl_resource_get_version(pResource);
-    }}
-            )#",
-                                  IFACE_CLASS_NAME_CAMEL);
-        } else {
-            HEADER += R"#(
-    // set the data for this resource
-    void setData(void* data) {{
-        pData = data;
-    }}
-
-    // get the data for this resource
-    void* data() {{
-        return pData;
-    }}
-
-    // get the raw wl_resource (wl_proxy) ptr
-    wl_proxy* resource() {{
-        return pResource;
-    }}
-
-    // get the raw wl_proxy ptr
-    wl_proxy* proxy() {{
-        return pResource;
-    }}
-
-    // get the resource version
-    int version() {{
-        return wl_proxy_get_version(pResource);
-    }}
-            )#";
+    size_t written = 0;
+    while (written < content.size()) {
+        const auto RET = write(FD, content.data() + written, content.size() - written);
+        if (RET < 0) {
+            if (errno == EINTR)
+                continue;
+            close(FD);
+            unlink(TMPPATH.c_str());
+            return false;
         }
+        written += RET;
+    }
 
-        // add all setters for requests
-        HEADER += "\n    // --------------- Requests --------------- //\n\n";
+    if (close(FD) != 0 || rename(TMPPATH.c_str(), path.c_str()) != 0) {
+        unlink(TMPPATH.c_str());
+        return false;
+    }
 
-        for (auto& rq : (clientCode ? iface.events : iface.requests)) {
+    return true;
+}
 
-            std::string args = ", ";
-            for (auto& arg : rq.args) {
-                if (arg.newType)
-                    continue;
-                args += WPTypeToCType(arg, false) + ", ";
-            }
+// parses, generates and writes out a single protocol.
+// Only touches ctx, so it's safe to run for many contexts at once.
+bool generateProtocol(SProtocolContext& ctx, const std::string& outpath) {
+    const auto& protopath  = ctx.protoPath;
 
-            args.pop_back();
-            args.pop_back();
+    auto        phaseStart  = std::chrono::steady_clock::now();
+    auto        allocsStart = allocCounter;
+    const auto  endPhase   = [&](SPhaseStats& phase) {
+        if (!ctx.options.stats)
+            return;
 
-            HEADER += std::format("    void {}(F<void({}*{})> &&handler);\n", camelize("set_" + rq.name), IFACE_CLASS_NAME_CAMEL, args);
-        }
+        const auto NOW = std::chrono::steady_clock::now();
+        phase.us       = std::chrono::duration_cast<std::chrono::microseconds>(NOW - phaseStart).count();
+        phaseStart     = NOW;
 
-        // start events
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+            phase.maxRssKb = usage.ru_maxrss;
 
-        HEADER += "\n    // --------------- Events --------------- //\n\n";
+        phase.allocs     = allocCounter.count - allocsStart.count;
+        phase.allocBytes = allocCounter.bytes - allocsStart.bytes;
+        allocsStart      = allocCounter;
+    };
 
-        for (auto& ev : (!clientCode ? iface.events : iface.requests)) {
-            std::string args = "";
-            for (auto& arg : ev.args) {
-                if (arg.newType)
-                    continue;
-                args += WPTypeToCType(arg, true) + ", ";
-            }
+    // a protocol from an earlier run (in --watch) points into the old mapping
+    ctx.protocol.reset();
 
-            if (!args.empty()) {
-                args.pop_back();
-                args.pop_back();
-            }
+    if (!ctx.input.map(protopath)) {
+        ctx.error = "Couldn't load proto " + protopath;
+        return false;
+    }
 
-            HEADER += std::format("    {} {}({});\n", ev.newIdType.empty() ? "void" : "wl_proxy*", camelize("send_" + ev.name), args);
-        }
+    // hashed before parsing, which rewrites the buffer
+    const std::string_view XML = ctx.input.view();
 
-        // dangerous ones
-        if (!clientCode) {
-            for (auto& ev : (!clientCode ? iface.events : iface.requests)) {
-                std::string args = "";
-                for (auto& arg : ev.args) {
-                    if (arg.newType)
-                        continue;
-                    args += WPTypeToCType(arg, true, true) + ", ";
-                }
+    ctx.fileName = protopath.substr(protopath.find_last_of('/') + 1, protopath.length() - (protopath.find_last_of('/') + 1) - 4);
 
-                if (!args.empty()) {
-                    args.pop_back();
-                    args.pop_back();
-                }
+    const auto STAMP = stampFor(ctx, XML);
+    ctx.stamp        = STAMP;
+    if (!ctx.options.force && isUpToDate(ctx, outpath, STAMP)) {
+        // the outputs keep their mtimes, but the stamp is bumped so build systems
+        // tracking it see that this input has been handled
+        utimensat(AT_FDCWD, stampPath(ctx, outpath).c_str(), nullptr, 0);
+        ctx.stats.upToDate = true;
+        endPhase(ctx.stats.load);
+        return true;
+    }
 
-                HEADER += std::format("    void {}({});\n", camelize("send_" + ev.name + "_raw"), args);
-            }
-        }
+    endPhase(ctx.stats.load);
 
-        // end events
+    try {
+        ctx.protocol = std::make_unique<HyprwaylandScanner::CProtocol>(std::span<char>{ctx.input.data(), XML.size()}, ctx.fileName, ctx.options.generation);
+        if (ctx.options.stats)
+            ctx.stats.interfaces = ctx.protocol->interfaceStats();
+        endPhase(ctx.stats.parse);
 
-        // start private section
-        HEADER += "\n  private:\n";
+        ctx.protocol->generateHeaders();
+        endPhase(ctx.stats.header);
 
-        // start requests storage
-        HEADER += "    struct {\n";
+        ctx.protocol->generateSource();
+        endPhase(ctx.stats.source);
+    } catch (std::exception& e) {
+        ctx.error = std::format("Failed to generate {}: {}", protopath, e.what());
+        return false;
+    }
 
-        for (auto& rq : (clientCode ? iface.events : iface.requests)) {
+    // what the last run generated, to clean up what this one doesn't anymore
+    std::string              oldStamp;
+    std::vector<std::string> oldOutputs;
+    readStamp(stampPath(ctx, outpath), oldStamp, oldOutputs);
+
+    ctx.outputs.clear();
+    const bool WRITTEN = ctx.protocol->write([&](const std::string& name, std::string_view content) {
+        const auto PATH = outpath + "/" + name;
+        if (!writeIfChanged(PATH, content)) {
+            ctx.error = std::format("Couldn't write {}", PATH);
+            return false;
+        }
 
-            std::string args = ", ";
-            for (auto& arg : rq.args) {
-                if (arg.newType)
-                    continue;
-                args += WPTypeToCType(arg, false) + ", ";
-            }
+        ctx.outputs.emplace_back(name);
 
-            if (!args.empty()) {
-                args.pop_back();
-                args.pop_back();
-            }
+        if (ctx.options.stats)
+            ctx.stats.outputs.emplace_back(PATH, content.size());
+        return true;
+    });
 
-            HEADER += std::format("        F<void({}*{})> {};\n", IFACE_CLASS_NAME_CAMEL, args, camelize(rq.name));
-        }
+    if (!WRITTEN)
+        return false;
 
-        // end requests storage
-        HEADER += "    } requests;\n";
+    for (auto& output : oldOutputs) {
+        if (std::find(ctx.outputs.begin(), ctx.outputs.end(), output) == ctx.outputs.end())
+            unlink((outpath + "/" + output).c_str());
+    }
 
-        // constant resource stuff
-        if (!clientCode) {
-            HEADER += std::format(R"#(
-    void onDestroyCalled();
+    std::string stampWithOutputs = STAMP;
+    for (auto& output : ctx.outputs) {
+        stampWithOutputs += output + "\n";
+    }
 
-    F<void({}*)> onDestroy;
+    // stamp last, so that a failed write above never looks up to date
+    if (!writeIfChanged(stampPath(ctx, outpath), stampWithOutputs) || utimensat(AT_FDCWD, stampPath(ctx, outpath).c_str(), nullptr, 0) != 0) {
+        ctx.error = std::format("Couldn't write the stamp of {} to {}", protopath, outpath);
+        return false;
+    }
 
-    wl_resource* pResource = nullptr;
+    endPhase(ctx.stats.write);
 
-    {}DestroyWrapper resourceDestroyListener;
+    return true;
+}
 
-    void* pData = nullptr;)#",
-                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
-        } else {
-            HEADER += R"#(
-    wl_proxy* pResource = nullptr;
+// one line per protocol, key=value pairs so tools (e.g. the benchmark) can pick them apart
+std::string formatStats(const SProtocolContext& ctx) {
+    if (ctx.stats.upToDate)
+        return std::format("stats {} up_to_date=1\n", ctx.protoPath);
 
-    bool destroyed = false;
+    std::string out = std::format("stats {}", ctx.protoPath);
+    for (const auto& [name, phase] : {std::pair{"load", ctx.stats.load}, std::pair{"parse", ctx.stats.parse}, std::pair{"header", ctx.stats.header},
+                                      std::pair{"source", ctx.stats.source}, std::pair{"write", ctx.stats.write}}) {
+        std::format_to(std::back_inserter(out), " {}_us={} {}_rss_kb={} {}_allocs={} {}_alloc_bytes={}", name, phase.us, name, phase.maxRssKb, name, phase.allocs, name,
+                       phase.allocBytes);
+    }
 
-    void* pData = nullptr;)#";
-        }
+    size_t outputBytes = 0;
+    for (auto& [path, bytes] : ctx.stats.outputs) {
+        outputBytes += bytes;
+    }
+    std::format_to(std::back_inserter(out), " output_bytes={}\n", outputBytes);
 
-        HEADER += "\n};\n\n";
+    for (auto& iface : ctx.stats.interfaces) {
+        std::format_to(std::back_inserter(out), "stats-interface {} {} handlers={} estimated_sizeof={}\n", ctx.protoPath, iface.className, iface.handlers, iface.estimatedSize);
     }
 
-    HEADER += "\n\n#undef F\n";
+    return out;
 }
 
-void parseSource() {
-    std::string DUMMY_TYPE_TABLE_NAME = PROTO_DATA.name + "_dummyTypes";
+std::string escapeJSON(std::string_view str) {
+    std::string out;
+    out.reserve(str.size());
+    for (const char c : str) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                    std::format_to(std::back_inserter(out), "\\u{:04x}", c);
+                else
+                    out += c;
+        }
+    }
+    return out;
+}
 
-    SOURCE += std::format(R"#(#define private public
-#define HYPRWAYLAND_SCANNER_NO_INTERFACES
-#include "{}.hpp"
-#undef private
-#define F std::function
-)#",
-                          PROTO_DATA.fileName);
+// the same as formatStats(), for all protocols at once, as JSON
+std::string formatReport(const std::vector<SProtocolContext>& contexts) {
+    std::string out = std::format("{{\n  \"scanner\": \"{}\",\n  \"protocols\": [", SCANNER_VERSION);
 
-    // reference interfaces
+    for (size_t i = 0; i < contexts.size(); ++i) {
+        const auto& ctx = contexts[i];
 
-    // dummy
-    SOURCE += std::format(R"#(
-static const wl_interface* {}[] = {{ nullptr }};
-)#", DUMMY_TYPE_TABLE_NAME);
+        std::format_to(std::back_inserter(out), "{}\n    {{\n      \"path\": \"{}\",\n      \"name\": \"{}\",\n      \"up_to_date\": {},\n      \"phases\": {{", i == 0 ? "" : ",",
+                       escapeJSON(ctx.protoPath), escapeJSON(ctx.protocol ? ctx.protocol->name() : ""), ctx.stats.upToDate);
 
-    SOURCE += R"#(
-// Reference all other interfaces.
-// The reason why this is in snake is to
-// be able to cooperate with existing
-// wayland_scanner interfaces (they are interop)
-)#";
+        bool first = true;
+        for (const auto& [name, phase] : {std::pair{"load", ctx.stats.load}, std::pair{"parse", ctx.stats.parse}, std::pair{"header", ctx.stats.header},
+                                          std::pair{"source", ctx.stats.source}, std::pair{"write", ctx.stats.write}}) {
+            std::format_to(std::back_inserter(out), "{}\n        \"{}\": {{\"us\": {}, \"rss_kb\": {}, \"allocs\": {}, \"alloc_bytes\": {}}}", first ? "" : ",", name, phase.us,
+                           phase.maxRssKb, phase.allocs, phase.allocBytes);
+            first = false;
+        }
 
-    std::vector<std::string> declaredIfaces;
+        out += "\n      },\n      \"outputs\": [";
+        first = true;
+        for (auto& [path, bytes] : ctx.stats.outputs) {
+            std::format_to(std::back_inserter(out), "{}\n        {{\"path\": \"{}\", \"bytes\": {}}}", first ? "" : ",", escapeJSON(path), bytes);
+            first = false;
+        }
 
-    for (auto& iface : XMLDATA.ifaces) {
-        const auto IFACE_WL_NAME       = iface.name + "_interface";
-        const auto IFACE_WL_NAME_CAMEL = camelize(iface.name + "_interface");
-        declaredIfaces.push_back(IFACE_WL_NAME);
+        out += "\n      ],\n      \"interfaces\": [";
+        first = true;
+        for (auto& iface : ctx.stats.interfaces) {
+            std::format_to(std::back_inserter(out), "{}\n        {{\"name\": \"{}\", \"class\": \"{}\", \"handlers\": {}, \"estimated_sizeof\": {}}}", first ? "" : ",",
+                           escapeJSON(iface.name), iface.className, iface.handlers, iface.estimatedSize);
+            first = false;
+        }
 
-        SOURCE += std::format("extern const wl_interface {};\n", IFACE_WL_NAME, IFACE_WL_NAME_CAMEL, IFACE_WL_NAME);
+        out += "\n      ]\n    }";
     }
 
-    for (auto& iface : XMLDATA.ifaces) {
-        // do all referenced too
-        for (auto& rq : iface.requests) {
-            for (auto& arg : rq.args) {
-                if (arg.interface.empty())
-                    continue;
+    out += "\n  ]\n}\n";
+    return out;
+}
 
-                const auto IFACE_WL_NAME2       = arg.interface + "_interface";
-                const auto IFACE_WL_NAME_CAMEL2 = camelize(arg.interface + "_interface");
+// the umbrella header first, then the source shards
+std::vector<std::string> amalgamationPaths(const SCliOptions& options, const std::string& outpath) {
+    auto paths = HyprwaylandScanner::amalgamationNames(options.amalgamate, options.shards, options.generation);
+    for (auto& path : paths) {
+        path = outpath + "/" + path;
+    }
+    return paths;
+}
 
-                if (std::find(declaredIfaces.begin(), declaredIfaces.end(), IFACE_WL_NAME2) == declaredIfaces.end()) {
-                    SOURCE += std::format("extern const wl_interface {};\n", IFACE_WL_NAME2, IFACE_WL_NAME_CAMEL2, IFACE_WL_NAME2);
-                    declaredIfaces.push_back(IFACE_WL_NAME2);
-                }
-            }
-        }
+std::string amalgamationStampPath(const SCliOptions& options, const std::string& outpath) {
+    return outpath + "/" + options.amalgamate + ".amalgamation.hws-stamp";
+}
 
-        for (auto& ev : iface.events) {
-            for (auto& arg : ev.args) {
-                if (arg.interface.empty())
-                    continue;
+// all protocol stamps in order, so any change to the set or to a protocol shows up
+std::string amalgamationStamp(const std::vector<SProtocolContext>& contexts, const SCliOptions& options) {
+    std::string stamp = std::format("shards={}\n", options.shards);
+    for (auto& ctx : contexts) {
+        stamp += ctx.protoPath + " " + ctx.stamp;
+    }
+    return stamp;
+}
 
-                const auto IFACE_WL_NAME2       = arg.interface + "_interface";
-                const auto IFACE_WL_NAME_CAMEL2 = camelize(arg.interface + "_interface");
+bool isAmalgamationUpToDate(const SCliOptions& options, const std::string& outpath, const std::string& stamp) {
+    if (!fileMatches(amalgamationStampPath(options, outpath), stamp))
+        return false;
 
-                if (std::find(declaredIfaces.begin(), declaredIfaces.end(), IFACE_WL_NAME2) == declaredIfaces.end()) {
-                    SOURCE += std::format("extern const wl_interface {};\n", IFACE_WL_NAME2, IFACE_WL_NAME_CAMEL2, IFACE_WL_NAME2);
-                    declaredIfaces.push_back(IFACE_WL_NAME2);
-                }
-            }
-        }
+    for (auto& path : amalgamationPaths(options, outpath)) {
+        if (!std::filesystem::exists(path))
+            return false;
     }
 
-    // declare ifaces
+    return true;
+}
 
-    for (auto& iface : XMLDATA.ifaces) {
+// see HyprwaylandScanner::amalgamate()
+bool writeAmalgamation(const std::vector<SProtocolContext>& contexts, const SCliOptions& options, const std::string& outpath) {
+    std::vector<const HyprwaylandScanner::CProtocol*> protocols;
+    for (auto& ctx : contexts) {
+        protocols.emplace_back(ctx.protocol.get());
+    }
 
-        const auto IFACE_WL_NAME          = iface.name + "_interface";
-        const auto IFACE_NAME             = iface.name;
-        const auto IFACE_NAME_CAMEL       = camelize(iface.name);
-        const auto IFACE_CLASS_NAME_CAMEL = camelize((clientCode ? "CC_" : "C_") + iface.name);
+    for (auto& [name, content] : HyprwaylandScanner::amalgamate(protocols, options.amalgamate, options.shards)) {
+        if (!writeIfChanged(outpath + "/" + name, content))
+            return false;
+    }
 
-        // create handlers
-        for (auto& rq : (clientCode ? iface.events : iface.requests)) {
-            const auto  REQUEST_NAME = camelize(std::string{"_"} + "C_" + IFACE_NAME + "_" + rq.name);
+    return true;
+}
 
-            std::string argsC = ", ";
-            for (auto& arg : rq.args) {
-                if (arg.newType)
-                    continue;
-                argsC += WPTypeToCType(arg, false) + " " + arg.name + ", ";
-            }
+// make escaping for paths in depfiles
+std::string escapeDepPath(const std::string& path) {
+    std::string out;
+    for (const char c : path) {
+        if (c == ' ' || c == '#' || c == '\\')
+            out += '\\';
+        else if (c == '$')
+            out += '$';
+        out += c;
+    }
+    return out;
+}
 
-            argsC.pop_back();
-            argsC.pop_back();
+// Make-format depfile: every output (and stamp) depends on every input and on the scanner itself.
+// Protocols don't pull in other files, so the inputs are just the protocols.
+std::string makeDepfile(const std::vector<SProtocolContext>& contexts, const std::string& outpath, const std::string& scannerPath) {
+    std::string out;
+    if (!contexts.empty() && !contexts.front().options.amalgamate.empty()) {
+        out += escapeDepPath(amalgamationStampPath(contexts.front().options, outpath)) + " ";
+        for (auto& path : amalgamationPaths(contexts.front().options, outpath)) {
+            out += escapeDepPath(path) + " ";
+        }
+    }
 
-            std::string argsN = ", ";
-            for (auto& arg : rq.args) {
-                argsN += arg.name + ", ";
-            }
+    for (auto& ctx : contexts) {
+        out += escapeDepPath(stampPath(ctx, outpath)) + " ";
+        for (auto& path : outputPaths(ctx, outpath)) {
+            out += escapeDepPath(path) + " ";
+        }
+    }
 
-            if (!argsN.empty()) {
-                argsN.pop_back();
-                argsN.pop_back();
-            }
+    if (!out.empty())
+        out.pop_back();
 
-            if (!clientCode) {
-                SOURCE += std::format(R"#(
-static void {}(wl_client* client, wl_resource* resource{}) {{
-    const auto PO = ({}*)wl_resource_get_user_data(resource);
-    if (PO && PO->requests.{})
-        PO->requests.{}(PO{});
-}}
-)#",
-                                      REQUEST_NAME, argsC, IFACE_CLASS_NAME_CAMEL, camelize(rq.name), camelize(rq.name), argsN);
-            } else {
-                SOURCE += std::format(R"#(
-static void {}(void* data, void* resource{}) {{
-    const auto PO = ({}*)data;
-    if (PO && PO->requests.{})
-        PO->requests.{}(PO{});
-}}
-)#",
-                                      REQUEST_NAME, argsC, IFACE_CLASS_NAME_CAMEL, camelize(rq.name), camelize(rq.name), argsN);
-            }
-        }
+    out += ":";
 
-        // destroy handler
-        if (!clientCode) {
-            SOURCE += std::format(R"#(
-static void _{}__DestroyListener(wl_listener* l, void* d) {{
-    {}DestroyWrapper *wrap = wl_container_of(l, wrap, listener);
-    {}* pResource = wrap->parent;
-    pResource->onDestroyCalled();
-}}
-)#",
-                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
+    for (auto& ctx : contexts) {
+        out += " \\\n  " + escapeDepPath(ctx.protoPath);
+    }
+
+    if (!contexts.empty()) {
+        for (auto& path : contexts.front().options.coalesceFiles) {
+            out += " \\\n  " + escapeDepPath(path);
         }
+    }
 
-        // create vtable
+    if (!scannerPath.empty())
+        out += " \\\n  " + escapeDepPath(scannerPath);
 
-        const auto IFACE_VTABLE_NAME = "_" + IFACE_CLASS_NAME_CAMEL + "VTable";
+    return out + "\n";
+}
 
-        SOURCE += std::format(R"#(
-static const void* {}[] = {{
-)#",
-                              IFACE_VTABLE_NAME);
+// runs generateProtocol for all given contexts on up to jobs threads
+void runJobs(const std::vector<SProtocolContext*>& contexts, size_t jobs, const std::string& outpath) {
+    if (contexts.empty())
+        return;
 
-        for (auto& rq : (clientCode ? iface.events : iface.requests)) {
-            const auto REQUEST_NAME = camelize(std::string{"_"} + "C_" + IFACE_NAME + "_" + rq.name);
-            SOURCE += std::format("    (void*){},\n", REQUEST_NAME);
-        }
+    jobs = std::clamp(jobs, (size_t)1, contexts.size());
 
-        if ((clientCode ? iface.events : iface.requests).empty()) {
-            SOURCE += "    nullptr,\n";
+    std::atomic<size_t> nextJob = 0;
+    const auto          worker  = [&]() {
+        for (size_t i = nextJob++; i < contexts.size(); i = nextJob++) {
+            generateProtocol(*contexts[i], outpath);
         }
+    };
 
-        SOURCE += "};\n";
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < jobs; ++i) {
+        threads.emplace_back(worker);
+    }
 
-        // create events
+    worker();
 
-        int evid = 0;
-        for (auto& ev : (!clientCode ? iface.events : iface.requests)) {
-            const auto  EVENT_NAME = camelize("send_" + ev.name);
+    for (auto& t : threads) {
+        t.join();
+    }
+}
 
-            std::string argsC = "";
-            for (auto& arg : ev.args) {
-                if (arg.newType)
-                    continue;
-                argsC += WPTypeToCType(arg, true) + " " + arg.name + ", ";
-            }
+// reads a response file: whitespace-separated paths, one or more per line
+bool readResponseFile(const std::string& path, std::vector<std::string>& out) {
+    std::ifstream in(path);
+    if (!in.good())
+        return false;
 
-            if (!argsC.empty()) {
-                argsC.pop_back();
-                argsC.pop_back();
-            }
+    std::string entry;
+    while (in >> entry) {
+        out.emplace_back(entry);
+    }
 
-            std::string argsN = ", ";
-            for (auto& arg : ev.args) {
-                if (arg.newType)
-                    argsN += "nullptr, ";
-                else if (!WPTypeToCType(arg, true).starts_with("C"))
-                    argsN += arg.name + ", ";
-                else
-                    argsN += (arg.name + " ? " + arg.name + "->pResource : nullptr, ");
-            }
+    return true;
+}
 
-            argsN.pop_back();
-            argsN.pop_back();
+// --watch: regenerates protocols as their xml changes, or their outputs get deleted or edited, until killed.
+// Watches directories rather than files, as editors tend to save by replacing the file.
+int watchProtocols(std::vector<SProtocolContext>& contexts, const SCliOptions& options, const std::string& outpath,
+                   const std::function<int(const std::vector<SProtocolContext*>&)>& build) {
+    const int FD = inotify_init1(IN_CLOEXEC);
+    if (FD < 0) {
+        std::cerr << "Couldn't start watching: " << strerror(errno) << "\n";
+        return 1;
+    }
 
-            if (!clientCode) {
-                SOURCE += std::format(R"#(
-void {}::{}({}) {{
-    if (!pResource)
-        return;
-    wl_resource_post_event(pResource, {}{});
-}}
-)#",
-                                      IFACE_CLASS_NAME_CAMEL, EVENT_NAME, argsC, evid, argsN);
-            } else {
-                std::string retType    = ev.newIdType.empty() ? "void" : "wl_proxy";
-                std::string ptrRetType = ev.newIdType.empty() ? "void" : "wl_proxy*";
-                std::string flags      = ev.destructor ? "1" : "0";
-                SOURCE += std::format(R"#(
-{} {}::{}({}) {{
-    if (!pResource)
-        return{};{}
-
-    auto proxy = wl_proxy_marshal_flags(pResource, {}, {}, wl_proxy_get_version(pResource), {}{});{}
-}}
-)#",
-                                      ptrRetType, IFACE_CLASS_NAME_CAMEL, EVENT_NAME, argsC, (ev.newIdType.empty() ? "" : " nullptr"),
-                                      (ev.destructor ? "\n    destroyed = true;" : ""), evid, (ev.newIdType.empty() ? "nullptr" : "&" + ev.newIdType + "_interface"), flags, argsN,
-                                      (ev.newIdType.empty() ? "\n    proxy;" : "\n\n    return proxy;"));
-            }
+    // the same directory may hold protocols and outputs, so collect the masks first
+    std::unordered_map<std::string, uint32_t> masks;
+    for (auto& ctx : contexts) {
+        const auto DIR = std::filesystem::path(ctx.protoPath).parent_path().string();
+        masks[DIR.empty() ? "." : DIR] |= IN_CLOSE_WRITE | IN_MOVED_TO;
+    }
+    masks[outpath] |= IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM;
+
+    std::unordered_map<int, std::string> dirs; // watch -> dir
+    for (auto& [dir, mask] : masks) {
+        const int WD = inotify_add_watch(FD, dir.c_str(), mask);
+        if (WD < 0) {
+            std::cerr << "Couldn't watch " << dir << ": " << strerror(errno) << "\n";
+            close(FD);
+            return 1;
+        }
+        dirs[WD] = dir;
+    }
+
+    const auto isDir = [](const std::string& a, const std::string& b) {
+        std::error_code ec;
+        return std::filesystem::equivalent(a, b, ec);
+    };
 
-            evid++;
+    std::cout << "Watching " << contexts.size() << " protocols" << std::endl;
+
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        // drop forces from the last round, e.g. by the amalgamation
+        for (auto& ctx : contexts) {
+            ctx.options.force = options.force;
         }
 
-        // dangerous
-        if (!clientCode) {
-            evid = 0;
-            for (auto& ev : iface.events) {
-                const auto  EVENT_NAME = camelize("send_" + ev.name + "_raw");
+        std::vector<SProtocolContext*> dirty;
+        const auto                       markDirty = [&](SProtocolContext& ctx, bool force) {
+            if (std::find(dirty.begin(), dirty.end(), &ctx) == dirty.end())
+                dirty.emplace_back(&ctx);
+            // an edited output still exists, so the stamp would call it up to date
+            if (force)
+                ctx.options.force = true;
+        };
+
+        // block for the first event, then give an editor a moment to finish saving
+        int timeout = -1;
+        while (true) {
+            pollfd pfd = {.fd = FD, .events = POLLIN, .revents = 0};
+            const int READY = poll(&pfd, 1, timeout);
+            if (READY < 0 && errno == EINTR)
+                continue;
+            if (READY <= 0)
+                break;
 
-                std::string argsC = "";
-                for (auto& arg : ev.args) {
-                    if (arg.newType)
-                        continue;
-                    argsC += WPTypeToCType(arg, true, true) + " " + arg.name + ", ";
-                }
+            const auto LEN = read(FD, buffer, sizeof(buffer));
+            if (LEN <= 0) {
+                if (LEN < 0 && errno == EINTR)
+                    continue;
+                std::cerr << "Couldn't read watch events: " << strerror(errno) << "\n";
+                close(FD);
+                return 1;
+            }
 
-                if (!argsC.empty()) {
-                    argsC.pop_back();
-                    argsC.pop_back();
-                }
+            for (ssize_t off = 0; off < LEN;) {
+                const auto* EVENT = reinterpret_cast<const inotify_event*>(buffer + off);
+                off += sizeof(inotify_event) + EVENT->len;
 
-                std::string argsN = ", ";
-                for (auto& arg : ev.args) {
-                    if (arg.newType)
-                        continue;
-                    argsN += arg.name + ", ";
-                }
+                if (!EVENT->len || !dirs.contains(EVENT->wd))
+                    continue;
 
-                argsN.pop_back();
-                argsN.pop_back();
+                const auto& DIR  = dirs[EVENT->wd];
+                const auto  NAME = std::string{EVENT->name};
 
-                SOURCE += std::format(R"#(
-void {}::{}({}) {{
-    if (!pResource)
-        return;
-    wl_resource_post_event(pResource, {}{});
-}}
-)#",
-                                      IFACE_CLASS_NAME_CAMEL, EVENT_NAME, argsC, evid, argsN);
+                for (auto& ctx : contexts) {
+                    const auto PATH = std::filesystem::path(ctx.protoPath);
+                    if ((EVENT->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && PATH.filename() == NAME && isDir(PATH.parent_path().empty() ? "." : PATH.parent_path(), DIR))
+                        markDirty(ctx, false);
 
-                evid++;
+                    if ((EVENT->mask & (IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM)) && isDir(outpath, DIR) &&
+                        std::find(ctx.outputs.begin(), ctx.outputs.end(), NAME) != ctx.outputs.end())
+                        markDirty(ctx, EVENT->mask & IN_CLOSE_WRITE);
+                }
             }
+
+            timeout = 50;
         }
 
-        // wayland interfaces and stuff
+        if (dirty.empty())
+            continue;
 
-        // type tables
-        for (auto& rq : iface.requests) {
-            if (rq.args.empty())
-                continue;
+        for (auto* ctx : dirty) {
+            ctx->error.clear();
+            ctx->stats = {};
+        }
 
-            const auto TYPE_TABLE_NAME = camelize(std::string{"_"} + "C_" + IFACE_NAME + "_" + rq.name + "_types");
-            SOURCE += std::format("static const wl_interface* {}[] = {{\n", TYPE_TABLE_NAME);
+        build(dirty);
 
-            for (auto& arg : rq.args) {
-                if (arg.interface.empty()) {
-                    SOURCE += "    nullptr,\n";
-                    continue;
-                }
+        for (auto* ctx : dirty) {
+            if (ctx->error.empty())
+                std::cout << (ctx->stats.upToDate ? "Unchanged " : "Regenerated ") << ctx->protoPath << std::endl;
+        }
+    }
+}
 
-                SOURCE += std::format("    &{}_interface,\n", arg.interface);
-            }
+int main(int argc, char** argv, char** envp) {
+    SCliOptions              options;
+    std::vector<std::string> paths;
+    size_t                   jobs = std::thread::hardware_concurrency();
+    std::string              depfile, report;
+    bool                     printStats = false;
 
-            SOURCE += "};\n";
+    for (int i = 1; i < argc; ++i) {
+        std::string curarg = argv[i];
+
+        if (curarg == "-v" || curarg == "--version") {
+            std::cout << SCANNER_VERSION << "\n";
+            return 0;
         }
-        for (auto& ev : iface.events) {
-            if (ev.args.empty())
-                continue;
 
-            const auto TYPE_TABLE_NAME = camelize(std::string{"_"} + "C_" + IFACE_NAME + "_" + ev.name + "_types");
-            SOURCE += std::format("static const wl_interface* {}[] = {{\n", TYPE_TABLE_NAME);
+        if (curarg == "-c" || curarg == "--client") {
+            options.generation.clientCode = true;
+            continue;
+        }
 
-            for (auto& arg : ev.args) {
-                if (arg.interface.empty()) {
-                    SOURCE += "    nullptr,\n";
-                    continue;
-                }
+        if (curarg == "--no-interfaces") {
+            options.generation.noInterfaces = true;
+            continue;
+        }
 
-                SOURCE += std::format("    &{}_interface,\n", arg.interface);
-            }
+        if (curarg == "--wayland-enums") {
+            options.generation.waylandEnums = true;
+            continue;
+        }
 
-            SOURCE += "};\n";
+        if (curarg == "--fwd-header") {
+            options.generation.fwdHeader = true;
+            continue;
         }
 
-        const auto MESSAGE_NAME_REQUESTS = camelize(std::string{"_"} + "C_" + IFACE_NAME + "_requests");
-        const auto MESSAGE_NAME_EVENTS   = camelize(std::string{"_"} + "C_" + IFACE_NAME + "_events");
-
-        // message
-        if (!noInterfaces) {
-            if (iface.requests.size() > 0) {
-                SOURCE += std::format(R"#(
-static const wl_message {}[] = {{
-)#",
-                                      MESSAGE_NAME_REQUESTS);
-                for (auto& rq : iface.requests) {
-                    // create type table
-                    const auto TYPE_TABLE_NAME = camelize(std::string{"_"} + "C_" + IFACE_NAME + "_" + rq.name + "_types");
-
-                    SOURCE += std::format("    {{ .name = \"{}\", .signature = \"{}\", .types = {}}},\n", rq.name, argsToShort(rq.args, rq.since),
-                                          rq.args.empty() ?  std::format("{} + 0", DUMMY_TYPE_TABLE_NAME) : TYPE_TABLE_NAME + " + 0");
-                }
+        if (curarg == "--stats") {
+            options.stats = true;
+            printStats    = true;
+            continue;
+        }
 
-                SOURCE += "};\n";
+        if (curarg == "--report") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << curarg << "\n";
+                return 1;
             }
 
-            if (iface.events.size() > 0) {
-                SOURCE += std::format(R"#(
-static const wl_message {}[] = {{
-)#",
-                                      MESSAGE_NAME_EVENTS);
-                for (auto& ev : iface.events) {
-                    // create type table
-                    const auto TYPE_TABLE_NAME = camelize(std::string{"_"} + "C_" + IFACE_NAME + "_" + ev.name + "_types");
-
-                    SOURCE += std::format("    {{ .name = \"{}\", .signature = \"{}\", .types = {}}},\n", ev.name, argsToShort(ev.args, ev.since),
-                                          ev.args.empty() ? std::format("{} + 0", DUMMY_TYPE_TABLE_NAME) : TYPE_TABLE_NAME + " + 0");
-                }
-
-                SOURCE += "};\n";
-            }
+            report = argv[++i];
+            continue;
+        }
 
-            // iface
-            SOURCE += std::format(R"#(
-const wl_interface {} = {{
-    .name = "{}", .version = {},
-    .method_count = {}, .methods = {},
-    .event_count = {}, .events = {},
-}};
-)#",
-                                  IFACE_WL_NAME, iface.name, iface.version, iface.requests.size(), (iface.requests.size() > 0 ? MESSAGE_NAME_REQUESTS : "nullptr"),
-                                  iface.events.size(), (iface.events.size() > 0 ? MESSAGE_NAME_EVENTS : "nullptr"));
+        if (curarg == "--watch") {
+            options.watch = true;
+            continue;
         }
 
-        // protocol body
-        if (!clientCode) {
-            SOURCE += std::format(R"#(
-{}::{}(wl_client* client, uint32_t version, uint32_t id) :
-    pResource(wl_resource_create(client, &{}, version, id)) {{
+        if (curarg == "--force") {
+            options.force = true;
+            continue;
+        }
 
-    if (!pResource)
-        return;
+        if (curarg == "--amalgamate") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << curarg << "\n";
+                return 1;
+            }
 
-    wl_resource_set_user_data(pResource, this);
-    wl_list_init(&resourceDestroyListener.listener.link);
-    resourceDestroyListener.listener.notify = _{}__DestroyListener;
-    resourceDestroyListener.parent = this;
-    wl_resource_add_destroy_listener(pResource, &resourceDestroyListener.listener);
-
-    wl_resource_set_implementation(pResource, {}, this, nullptr);
-}}
-
-{}::~{}() {{
-    wl_list_remove(&resourceDestroyListener.listener.link);
-    wl_list_init(&resourceDestroyListener.listener.link);
-
-    // if we still own the wayland resource,
-    // it means we need to destroy it.
-    if (pResource && wl_resource_get_user_data(pResource) == this) {{
-        wl_resource_set_user_data(pResource, nullptr);
-        wl_resource_destroy(pResource);
-    }}
-}}
-
-void {}::onDestroyCalled() {{
-    wl_resource_set_user_data(pResource, nullptr);
-    wl_list_remove(&resourceDestroyListener.listener.link);
-    wl_list_init(&resourceDestroyListener.listener.link);
-
-    // set the resource to nullptr,
-    // as it will be freed. If the consumer does not destroy this resource
-    // in onDestroy here, we'd be doing a UAF in the ~dtor
-    pResource = nullptr;
-
-    if (onDestroy)
-        onDestroy(this);
-}}
-)#",
-                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_NAME + "_interface", IFACE_CLASS_NAME_CAMEL, IFACE_VTABLE_NAME, IFACE_CLASS_NAME_CAMEL,
-                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL);
-        } else {
-            std::string DTOR_FUNC = "";
-
-            for (auto& rq : iface.requests) {
-                if (!rq.destructor)
-                    continue;
+            options.amalgamate = argv[++i];
+            continue;
+        }
 
-                DTOR_FUNC = camelize("send_" + rq.name) + "()";
-                break;
+        if (curarg == "--shards") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << curarg << "\n";
+                return 1;
             }
 
-            if (DTOR_FUNC.empty())
-                DTOR_FUNC = "wl_proxy_destroy(pResource)";
+            try {
+                options.shards = std::max(1UL, std::stoul(argv[++i]));
+            } catch (std::exception& e) {
+                std::cerr << "Invalid value for " << curarg << ": " << argv[i] << "\n";
+                return 1;
+            }
+            continue;
+        }
 
-            SOURCE += std::format(R"#(
-{}::{}(wl_proxy* resource) : pResource(resource) {{
+        if (curarg == "--coalesce") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << curarg << "\n";
+                return 1;
+            }
 
-    if (!pResource)
-        return;
+            // a comma separated list, or @file with one or more per line
+            const std::string VALUE = argv[++i];
+            if (VALUE.starts_with("@")) {
+                if (!readResponseFile(VALUE.substr(1), options.generation.coalesce)) {
+                    std::cerr << "Couldn't read " << VALUE.substr(1) << "\n";
+                    return 1;
+                }
+                options.coalesceFiles.emplace_back(VALUE.substr(1));
+            } else {
+                for (const auto& name : std::views::split(VALUE, ',')) {
+                    if (!name.empty())
+                        options.generation.coalesce.emplace_back(std::string_view{name});
+                }
+            }
+            continue;
+        }
 
-    wl_proxy_add_listener(pResource, (void (**)(void))&{}, this);
-}}
+        if (curarg == "--loadgen") {
+            options.generation.loadgen = true;
+            continue;
+        }
 
-{}::~{}() {{
-    if (!destroyed)
-        {};
-}}
-)#",
-                                  IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, IFACE_VTABLE_NAME, IFACE_CLASS_NAME_CAMEL, IFACE_CLASS_NAME_CAMEL, DTOR_FUNC);
+        if (curarg == "--bench-harness") {
+            options.generation.benchHarness = true;
+            continue;
         }
 
-        for (auto& rq : (clientCode ? iface.events : iface.requests)) {
-            std::string args = ", ";
-            for (auto& arg : rq.args) {
-                args += WPTypeToCType(arg, false) + ", ";
-            }
+        if (curarg == "--record") {
+            options.generation.record = true;
+            continue;
+        }
 
-            args.pop_back();
-            args.pop_back();
+        if (curarg == "--instrument") {
+            options.generation.instrument = true;
+            continue;
+        }
 
-            SOURCE += std::format(R"#(
-void {}::{}(F<void({}*{})> &&handler) {{
-    requests.{} = std::move(handler);
-}}
-)#",
-                                  IFACE_CLASS_NAME_CAMEL, camelize("set_" + rq.name), IFACE_CLASS_NAME_CAMEL, args, camelize(rq.name));
+        if (curarg == "--broadcast") {
+            options.generation.broadcast = true;
+            continue;
         }
-    }
 
-    SOURCE += "\n#undef F\n";
-}
+        if (curarg == "--event-queues") {
+            options.generation.eventQueues = true;
+            continue;
+        }
 
-int main(int argc, char** argv, char** envp) {
-    std::string outpath   = "";
-    std::string protopath = "";
+        if (curarg == "--marshal-array") {
+            options.generation.marshalArray = true;
+            continue;
+        }
 
-    int         pathsTaken = 0;
+        if (curarg == "--pool") {
+            options.generation.pool = true;
+            continue;
+        }
 
-    for (int i = 1; i < argc; ++i) {
-        std::string curarg = argv[i];
+        if (curarg == "--static-dispatch") {
+            options.generation.staticDispatch = true;
+            continue;
+        }
 
-        if (curarg == "-v" || curarg == "--version") {
-            std::cout << SCANNER_VERSION << "\n";
-            return 0;
+        if (curarg == "--delegate") {
+            options.generation.delegate = true;
+            continue;
         }
 
-        if (curarg == "-c" || curarg == "--client") {
-            clientCode = true;
+        if (curarg == "--split-source") {
+            options.splitSource = true;
             continue;
         }
 
-        if (curarg == "--no-interfaces") {
-            noInterfaces = true;
+        if (curarg == "--module") {
+            options.generation.module = true;
             continue;
         }
 
-        if (curarg == "--wayland-enums") {
-            waylandEnums = true;
+        if (curarg == "--depfile") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << curarg << "\n";
+                return 1;
+            }
+
+            depfile = argv[++i];
             continue;
         }
 
-        if (pathsTaken == 0) {
-            protopath = curarg;
-            pathsTaken++;
+        if (curarg == "-j" || curarg == "--jobs") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << curarg << "\n";
+                return 1;
+            }
+
+            try {
+                jobs = std::stoul(argv[++i]);
+            } catch (std::exception& e) {
+                std::cerr << "Invalid value for " << curarg << ": " << argv[i] << "\n";
+                return 1;
+            }
             continue;
-        } else if (pathsTaken == 1) {
-            outpath = curarg;
-            pathsTaken++;
+        }
+
+        if (curarg.starts_with("@")) {
+            if (!readResponseFile(curarg.substr(1), paths)) {
+                std::cerr << "Couldn't read response file " << curarg.substr(1) << "\n";
+                return 1;
+            }
             continue;
         }
 
-        std::cout << "Too many args or unknown arg " << curarg << "\n";
-        return 1;
+        if (curarg.starts_with("-")) {
+            std::cout << "Unknown arg " << curarg << "\n";
+            return 1;
+        }
+
+        paths.emplace_back(curarg);
     }
 
-    if (outpath.empty() || protopath.empty()) {
+    if (paths.size() < 2) {
         std::cerr << "Not enough args\n";
         return 1;
     }
 
-    // build!
+    // a report covers every protocol, not only the ones that changed
+    if (!report.empty()) {
+        options.stats = true;
+        options.force = true;
+    }
 
-    pugi::xml_document doc;
-    if (!doc.load_file(protopath.c_str())) {
-        std::cerr << "Couldn't load proto\n";
+    if (options.generation.module && options.generation.fwdHeader) {
+        std::cerr << "--fwd-header can't be used with --module\n";
         return 1;
     }
 
-    PROTO_DATA.nameOriginal = doc.child("protocol").attribute("name").as_string();
-    PROTO_DATA.name         = camelize(PROTO_DATA.nameOriginal);
-    PROTO_DATA.fileName     = protopath.substr(protopath.find_last_of('/') + 1, protopath.length() - (protopath.find_last_of('/') + 1) - 4);
-
-    const auto COPYRIGHT =
-        std::format("// Generated with hyprwayland-scanner {}. Made with vaxry's keyboard and ❤️.\n// {}\n\n/*\n This protocol's authors' copyright notice is:\n\n{}\n*/\n\n",
-                    SCANNER_VERSION, PROTO_DATA.nameOriginal, std::string{doc.child("protocol").child("copyright").child_value()});
+    if (options.splitSource && (options.generation.module || !options.amalgamate.empty())) {
+        std::cerr << "--split-source can't be used with --module or --amalgamate\n";
+        return 1;
+    }
 
-    parseXML(doc);
-    parseHeader();
-    parseSource();
+    if (options.generation.broadcast && options.generation.clientCode) {
+        std::cerr << "--broadcast can't be used with --client\n";
+        return 1;
+    }
 
-    const auto HPATH              = outpath + "/" + PROTO_DATA.fileName + ".hpp";
-    const auto CPATH              = outpath + "/" + PROTO_DATA.fileName + ".cpp";
-    bool       needsToWriteHeader = true, needsToWriteSource = true;
+    if (options.generation.eventQueues && !options.generation.clientCode) {
+        std::cerr << "--event-queues can only be used with --client\n";
+        return 1;
+    }
 
-    if (std::filesystem::exists(HPATH)) {
-        // check if we need to overwrite
+    if ((options.generation.benchHarness || options.generation.loadgen) && options.generation.module) {
+        std::cerr << "--bench-harness and --loadgen can't be used with --module\n";
+        return 1;
+    }
 
-        std::ifstream headerIn(HPATH);
-        std::string   content((std::istreambuf_iterator<char>(headerIn)), (std::istreambuf_iterator<char>()));
+    if (options.generation.benchHarness && options.generation.staticDispatch) {
+        std::cerr << "--bench-harness can't be used with --static-dispatch\n";
+        return 1;
+    }
 
-        if (content == COPYRIGHT + HEADER)
-            needsToWriteHeader = false;
+    if (options.generation.loadgen && options.generation.staticDispatch && !options.generation.clientCode) {
+        std::cerr << "--loadgen can't be used with --static-dispatch without --client\n";
+        return 1;
+    }
 
-        headerIn.close();
+    if (options.generation.module && options.amalgamate.empty() && options.shards > 1) {
+        std::cerr << "--shards can't be used with --module without --amalgamate\n";
+        return 1;
     }
 
-    if (std::filesystem::exists(CPATH)) {
-        // check if we need to overwrite
+    countAllocations = options.stats;
 
-        std::ifstream sourceIn(CPATH);
-        std::string   content((std::istreambuf_iterator<char>(sourceIn)), (std::istreambuf_iterator<char>()));
+    // how the CLI splits the sources, as the library takes it
+    options.generation.amalgamated = !options.amalgamate.empty();
+    if (!options.generation.amalgamated)
+        options.generation.sourceShards = options.splitSource ? 0 : options.shards;
 
-        if (content == COPYRIGHT + SOURCE)
-            needsToWriteSource = false;
+    // the last path is the output dir, everything before it is a protocol
+    const std::string               outpath = paths.back();
+    paths.pop_back();
 
-        sourceIn.close();
+    // every protocol only looks for its own messages, so a typo would do nothing
+    if (!options.generation.coalesce.empty()) {
+        std::vector<CMappedFile>      inputs(paths.size());
+        std::vector<std::string_view> xmls;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (inputs[i].map(paths[i]))
+                xmls.emplace_back(inputs[i].view());
+        }
+
+        const auto UNKNOWN = HyprwaylandScanner::unknownCoalesced(xmls, options.generation);
+        for (auto& name : UNKNOWN) {
+            std::cerr << std::format("--coalesce: {} isn't {} of the given protocols\n", name, options.generation.clientCode ? "a request" : "an event");
+        }
+
+        if (!UNKNOWN.empty())
+            return 1;
     }
 
-    if (needsToWriteHeader) {
-        std::ofstream header(HPATH, std::ios::trunc);
-        header << COPYRIGHT << HEADER;
-        header.close();
+    std::vector<SProtocolContext> contexts(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        contexts[i].options   = options;
+        contexts[i].protoPath = paths[i];
     }
 
-    if (needsToWriteSource) {
-        std::ofstream source(CPATH, std::ios::trunc);
-        source << COPYRIGHT << SOURCE;
-        source.close();
+    std::error_code ec;
+    auto            scannerPath = std::filesystem::read_symlink("/proc/self/exe", ec).string();
+    if (ec)
+        scannerPath = std::filesystem::absolute(argv[0], ec).string();
+
+    // generates the given protocols, then redoes everything that depends on all of them
+    const auto build = [&](const std::vector<SProtocolContext*>& dirty) -> int {
+        runJobs(dirty, jobs, outpath);
+
+        const bool FAILED = std::any_of(contexts.begin(), contexts.end(), [](const auto& ctx) { return !ctx.error.empty(); });
+
+        if (!FAILED && !options.amalgamate.empty()) {
+            const auto STAMP    = amalgamationStamp(contexts, options);
+            const bool UPTODATE = !options.force && std::all_of(contexts.begin(), contexts.end(), [](const auto& ctx) { return ctx.stats.upToDate; }) &&
+                isAmalgamationUpToDate(options, outpath, STAMP);
+
+            if (!UPTODATE) {
+                // protocols skipped by their stamps have no code to amalgamate yet
+                std::vector<SProtocolContext*> skipped;
+                for (auto& ctx : contexts) {
+                    if (!ctx.stats.upToDate || ctx.protocol)
+                        continue;
+
+                    ctx.options.force = true;
+                    ctx.stats         = {};
+                    skipped.emplace_back(&ctx);
+                }
+
+                runJobs(skipped, jobs, outpath);
+
+                if (std::all_of(contexts.begin(), contexts.end(), [](const auto& ctx) { return ctx.error.empty(); }) &&
+                    (!writeAmalgamation(contexts, options, outpath) || !writeIfChanged(amalgamationStampPath(options, outpath), STAMP))) {
+                    std::cerr << "Couldn't write amalgamation " << options.amalgamate << "\n";
+                    return 1;
+                }
+            }
+
+            utimensat(AT_FDCWD, amalgamationStampPath(options, outpath).c_str(), nullptr, 0);
+        }
+
+        int ret = 0;
+        for (auto* ctx : dirty) {
+            if (printStats && ctx->error.empty())
+                std::cout << formatStats(*ctx);
+
+            if (ctx->error.empty())
+                continue;
+
+            std::cerr << ctx->error << "\n";
+            ret = 1;
+        }
+
+        if (ret == 0 && !report.empty() && !writeIfChanged(report, formatReport(contexts))) {
+            std::cerr << "Couldn't write report " << report << "\n";
+            ret = 1;
+        }
+
+        if (ret == 0 && !depfile.empty() && !writeIfChanged(depfile, makeDepfile(contexts, outpath, scannerPath))) {
+            std::cerr << "Couldn't write depfile " << depfile << "\n";
+            ret = 1;
+        }
+
+        return ret;
+    };
+
+    // build!
+
+    std::vector<SProtocolContext*> all;
+    for (auto& ctx : contexts) {
+        all.emplace_back(&ctx);
     }
 
-    return 0;
+    const int RET = build(all);
+
+    if (!options.watch)
+        return RET;
+
+    return watchProtocols(contexts, options, outpath, build);
 }
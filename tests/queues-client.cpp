@@ -0,0 +1,84 @@
+// --event-queues: objects created on a queue only dispatch there, and so do ones moved to it afterwards
+#include "client/hws-test.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <sys/socket.h>
+#include <thread>
+
+extern std::atomic<bool> quit;
+void                     runServer(int fd);
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+int main() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        return 1;
+
+    std::thread server(runServer, fds[0]);
+
+    auto                              display  = wl_display_connect_to_fd(fds[1]);
+    auto                              registry = wl_display_get_registry(display);
+    static uint32_t                   name     = 0;
+    static const wl_registry_listener LISTENER = {
+        .global        = [](void*, wl_registry*, uint32_t global, const char*, uint32_t) { name = global; },
+        .global_remove = [](void*, wl_registry*, uint32_t) {},
+    };
+    wl_registry_add_listener(registry, &LISTENER, nullptr);
+    wl_display_roundtrip(display);
+
+    auto manager = std::make_unique<CCHwsManager>((wl_proxy*)wl_registry_bind(registry, name, &hws_manager_interface, 2));
+    auto queue   = wl_display_create_queue(display);
+
+    // made on the queue, and its callback inherits it
+    auto queued  = std::make_unique<CCHwsSurface>(manager->sendCreateSurface(queue), queue);
+    int  onQueue = 0;
+    auto first   = std::make_unique<CCHwsCallback>(queued->sendFrame());
+    first->setDone([&](CCHwsCallback*, uint32_t data) { onQueue += data == 42; });
+
+    wl_display_roundtrip(display);
+    check(onQueue == 0, "the default queue doesn't dispatch a queued object");
+    wl_display_roundtrip_queue(display, queue);
+    check(onQueue == 1, "its queue does");
+
+    // made on the default queue, and one of its callbacks moved to the queue
+    auto surface   = std::make_unique<CCHwsSurface>(manager->sendCreateSurface());
+    int  onDefault = 0;
+    int  moved     = 0;
+    auto second    = std::make_unique<CCHwsCallback>(surface->sendFrame());
+    auto third     = std::make_unique<CCHwsCallback>(surface->sendFrame(), queue);
+    second->setDone([&](CCHwsCallback*, uint32_t) { onDefault++; });
+    third->setDone([&](CCHwsCallback*, uint32_t) { moved++; });
+
+    wl_display_roundtrip_queue(display, queue);
+    check(onDefault == 0 && moved == 1, "setting the queue of an object moves it");
+    wl_display_roundtrip(display);
+    check(onDefault == 1 && moved == 1, "and leaves the others");
+
+    first.reset();
+    second.reset();
+    third.reset();
+    queued.reset();
+    surface.reset();
+    manager.reset();
+    wl_registry_destroy(registry);
+    wl_event_queue_destroy(queue);
+
+    quit = true;
+    server.join();
+    wl_display_disconnect(display);
+
+    if (failures == 0)
+        std::printf("queues ok\n");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+// the server of queues-client.cpp, on a thread of its own
+#include "server/hws-test.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+static std::vector<std::unique_ptr<CHwsManager>>  managers;
+static std::vector<std::unique_ptr<CHwsSurface>>  surfaces;
+static std::vector<std::unique_ptr<CHwsCallback>> callbacks;
+std::atomic<bool>                                 quit = false;
+
+void runServer(int fd) {
+    auto display = wl_display_create();
+    wl_global_create(display, &hws_manager_interface, 2, nullptr, [](wl_client* client, void*, uint32_t version, uint32_t id) {
+        auto& manager = managers.emplace_back(std::make_unique<CHwsManager>(client, version, id));
+        manager->setCreateSurface([](CHwsManager* r, uint32_t id) {
+            auto& surface = surfaces.emplace_back(std::make_unique<CHwsSurface>(r->client(), r->version(), id));
+            surface->setFrame([](CHwsSurface* r, uint32_t id) {
+                auto& callback = callbacks.emplace_back(std::make_unique<CHwsCallback>(r->client(), 1, id));
+                callback->sendDone(42);
+            });
+        });
+    });
+    wl_client_create(display, fd);
+
+    auto loop = wl_display_get_event_loop(display);
+    while (!quit) {
+        wl_event_loop_dispatch(loop, 10);
+        wl_display_flush_clients(display);
+    }
+
+    callbacks.clear();
+    surfaces.clear();
+    managers.clear();
+    wl_display_destroy_clients(display);
+    wl_display_destroy(display);
+}
+
@@ -0,0 +1,68 @@
+// --event-queues with --static-dispatch: the queue overloads of the static classes
+#include "client/hws-test.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <sys/socket.h>
+#include <thread>
+
+extern std::atomic<bool> quit;
+void                     runServer(int fd);
+
+class CCallback : public CCHwsCallbackStatic<CCallback> {
+  public:
+    CCallback(wl_proxy* resource, wl_event_queue* queue) : CCHwsCallbackStatic(resource, queue) {}
+
+    void done(uint32_t data) {
+        this->data = data;
+    }
+
+    uint32_t data = 0;
+};
+
+int main() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        return 1;
+
+    std::thread server(runServer, fds[0]);
+
+    auto                              display  = wl_display_connect_to_fd(fds[1]);
+    auto                              registry = wl_display_get_registry(display);
+    static uint32_t                   name     = 0;
+    static const wl_registry_listener LISTENER = {
+        .global        = [](void*, wl_registry*, uint32_t global, const char*, uint32_t) { name = global; },
+        .global_remove = [](void*, wl_registry*, uint32_t) {},
+    };
+    wl_registry_add_listener(registry, &LISTENER, nullptr);
+    wl_display_roundtrip(display);
+
+    auto manager  = std::make_unique<CCHwsManager>((wl_proxy*)wl_registry_bind(registry, name, &hws_manager_interface, 2));
+    auto queue    = wl_display_create_queue(display);
+    auto surface  = std::make_unique<CCHwsSurface>(manager->sendCreateSurface());
+    auto callback = std::make_unique<CCallback>(surface->sendFrame(queue), queue);
+
+    wl_display_roundtrip(display);
+    const bool DEFAULT = callback->data == 0;
+    wl_display_roundtrip_queue(display, queue);
+    const bool QUEUED = callback->data == 42;
+
+    callback.reset();
+    surface.reset();
+    manager.reset();
+    wl_registry_destroy(registry);
+    wl_event_queue_destroy(queue);
+
+    quit = true;
+    server.join();
+    wl_display_disconnect(display);
+
+    if (!DEFAULT || !QUEUED) {
+        std::printf("FAIL: the static callback %s\n", DEFAULT ? "wasn't dispatched on its queue" : "was dispatched on the default queue");
+        return 1;
+    }
+
+    std::printf("static queues ok\n");
+    return 0;
+}
@@ -0,0 +1,60 @@
+// --record: what the ring holds when never started, empty and wrapped around
+#include "server/hws-test.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using Hyprwayland::CRecorder;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+int main() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        return 1;
+
+    auto display = wl_display_create();
+    auto client  = wl_client_create(display, fds[0]);
+    auto surface = new CHwsSurface(client, 2, 0);
+
+    const auto NEVER = CRecorder::dump();
+    check(NEVER.size() == sizeof(CRecorder::MAGIC) && std::memcmp(NEVER.data(), CRecorder::MAGIC, sizeof(CRecorder::MAGIC)) == 0, "dump before start is just the magic");
+
+    // without room, nothing is kept
+    CRecorder::start(0);
+    surface->sendMotion(1, wl_fixed_from_int(1), wl_fixed_from_int(2));
+    check(CRecorder::dump().size() == sizeof(CRecorder::MAGIC), "start(0) records nothing");
+
+    CRecorder::start(4096);
+    surface->sendMotion(2, wl_fixed_from_int(3), wl_fixed_from_int(4));
+    const auto ONE = CRecorder::dump();
+    check(ONE.size() > sizeof(CRecorder::MAGIC), "a sent event is recorded");
+
+    // a ring of a few messages only keeps the latest
+    CRecorder::start(ONE.size() * 2);
+    for (uint32_t i = 0; i < 100; ++i) {
+        surface->sendMotion(i, wl_fixed_from_int(i), wl_fixed_from_int(i));
+    }
+    const auto WRAPPED = CRecorder::dump();
+    check(WRAPPED.size() > sizeof(CRecorder::MAGIC) && WRAPPED.size() <= sizeof(CRecorder::MAGIC) + ONE.size() * 2, "a full ring drops the oldest");
+    CRecorder::stop();
+
+    delete surface;
+    wl_client_destroy(client);
+    wl_display_destroy(display);
+    close(fds[1]);
+
+    if (failures == 0)
+        std::printf("recorder ok\n");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+# Runs one scanner test, as cmake -P:
+#   generates PROTOCOL into WORKDIR/server and/or WORKDIR/client with SERVER_FLAGS / CLIENT_FLAGS,
+#   compiles every generated source (and SOURCES) with CXX, and with RUN links them into a program,
+#   runs it with ARGS and checks its output matches EXPECT. SOURCES include the sides' headers as "server/<proto>.hpp".
+# Lists are passed space-separated, as -D can't carry ;
+
+separate_arguments(SERVER_FLAGS UNIX_COMMAND "${SERVER_FLAGS}")
+separate_arguments(CLIENT_FLAGS UNIX_COMMAND "${CLIENT_FLAGS}")
+separate_arguments(CXXFLAGS UNIX_COMMAND "${CXXFLAGS}")
+separate_arguments(LIBS UNIX_COMMAND "${LIBS}")
+separate_arguments(SOURCES UNIX_COMMAND "${SOURCES}")
+separate_arguments(ARGS UNIX_COMMAND "${ARGS}")
+separate_arguments(SIDES UNIX_COMMAND "${SIDES}")
+
+file(REMOVE_RECURSE "${WORKDIR}")
+
+set(OBJECTS)
+foreach(SIDE ${SIDES})
+  if(SIDE STREQUAL "server")
+    set(FLAGS ${SERVER_FLAGS})
+  else()
+    set(FLAGS ${CLIENT_FLAGS})
+  endif()
+
+  set(OUT "${WORKDIR}/${SIDE}")
+  file(MAKE_DIRECTORY "${OUT}")
+  execute_process(
+    COMMAND "${SCANNER}" ${FLAGS} "${PROTOCOL}" "${OUT}"
+    RESULT_VARIABLE RESULT
+    OUTPUT_VARIABLE OUTPUT
+    ERROR_VARIABLE OUTPUT)
+  if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "${SIDE}: scanner ${FLAGS} failed (${RESULT}):\n${OUTPUT}")
+  endif()
+
+  # a module interface unit is compiled as one, where the compiler knows how
+  file(GLOB GENERATED "${OUT}/*.cpp" "${OUT}/*.cppm")
+  if(NOT GENERATED)
+    message(FATAL_ERROR "${SIDE}: scanner ${FLAGS} generated no sources")
+  endif()
+
+  foreach(SOURCE ${GENERATED})
+    set(MODE_FLAGS)
+    if(SOURCE MATCHES "\\.cppm$")
+      if(CXX_ID STREQUAL "GNU")
+        set(MODE_FLAGS -fmodules-ts -x c++)
+      elseif(CXX_ID MATCHES "Clang")
+        set(MODE_FLAGS -x c++-module)
+      else()
+        message(STATUS "${SIDE}: not compiling ${SOURCE}, no module support known for ${CXX_ID}")
+        continue()
+      endif()
+    endif()
+
+    get_filename_component(NAME "${SOURCE}" NAME_WE)
+    set(OBJECT "${OUT}/${NAME}.o")
+    execute_process(
+      COMMAND "${CXX}" ${CXXFLAGS} ${MODE_FLAGS} -I "${OUT}" -c "${SOURCE}" -o "${OBJECT}"
+      WORKING_DIRECTORY "${OUT}"
+      RESULT_VARIABLE RESULT
+      OUTPUT_VARIABLE OUTPUT
+      ERROR_VARIABLE OUTPUT)
+    if(NOT RESULT EQUAL 0)
+      message(FATAL_ERROR "${SIDE}: compiling ${SOURCE} failed:\n${OUTPUT}")
+    endif()
+    list(APPEND OBJECTS "${OBJECT}")
+  endforeach()
+endforeach()
+
+if(NOT RUN)
+  return()
+endif()
+
+execute_process(
+  COMMAND "${CXX}" ${CXXFLAGS} -I "${WORKDIR}" ${SOURCES} ${OBJECTS} ${LIBS} -o "${WORKDIR}/test"
+  RESULT_VARIABLE RESULT
+  OUTPUT_VARIABLE OUTPUT
+  ERROR_VARIABLE OUTPUT)
+if(NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "linking failed:\n${OUTPUT}")
+endif()
+
+execute_process(
+  COMMAND "${WORKDIR}/test" ${ARGS}
+  WORKING_DIRECTORY "${WORKDIR}"
+  TIMEOUT 60
+  RESULT_VARIABLE RESULT
+  OUTPUT_VARIABLE OUTPUT
+  ERROR_VARIABLE OUTPUT)
+message("${OUTPUT}")
+if(NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "test exited with ${RESULT}")
+endif()
+if(EXPECT AND NOT OUTPUT MATCHES "${EXPECT}")
+  message(FATAL_ERROR "output doesn't match ${EXPECT}")
+endif()